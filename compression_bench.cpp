@@ -0,0 +1,104 @@
+#include "stylizer/core/compression.hpp"
+
+#include <iostream>
+#include <random>
+
+// CPU only, checks block compression quality and throughput and that the SSE2 and scalar kernels agree
+// Usage: stylizer_compression_bench [iterations] [minimum megapixels per second]
+
+namespace {
+	struct test_image {
+		std::string_view name;
+		std::vector<std::byte> pixels;
+		stylizer::uint2 size;
+
+		stylizer::image_view view() const { return {pixels, size}; }
+	};
+
+	// Smooth gradients with a hard edge and some noise, a mix of the easy and hard cases for a block encoder
+	test_image generate(std::string_view name, stylizer::uint2 size, uint32_t seed) {
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		test_image out{name, std::vector<std::byte>(size_t(size.x) * size.y * 4), size};
+		for(size_t y = 0; y < size.y; ++y)
+			for(size_t x = 0; x < size.x; ++x) {
+				bool edge = x * size.y > y * size.x; // Diagonal split
+				int base[4] = {
+					int(x * 255 / size.x),
+					int(y * 255 / size.y),
+					edge ? 200 : 40,
+					int((x + y) * 255 / (size.x + size.y))
+				};
+				for(size_t c = 0; c < 4; ++c)
+					out.pixels[(y * size.x + x) * 4 + c] = std::byte(std::clamp(base[c] + noise(rng), 0, 255));
+			}
+		return out;
+	}
+
+	std::string_view format_name(stylizer::block_format format) {
+		switch(format) {
+			case stylizer::block_format::BC1: return "BC1";
+			case stylizer::block_format::BC3: return "BC3";
+			case stylizer::block_format::BC5: return "BC5";
+			case stylizer::block_format::BC7: return "BC7";
+		}
+		return "?";
+	}
+
+	// Conservative floors, the noise keeps any format from being lossless
+	double minimum_psnr(stylizer::block_format format) {
+		switch(format) {
+			case stylizer::block_format::BC1: return 30;
+			case stylizer::block_format::BC3: return 30;
+			case stylizer::block_format::BC5: return 40;
+			case stylizer::block_format::BC7: return 30;
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char** argv) {
+	using stylizer::texture_compression;
+	size_t iterations = argc > 1 ? std::stoul(argv[1]) : 4;
+	double minimum_throughput = argc > 2 ? std::stod(argv[2]) : 1;
+
+	std::vector<test_image> images;
+	images.emplace_back(generate("512x512", {512, 512}, 1));
+	images.emplace_back(generate("67x45 (partial blocks)", {67, 45}, 2));
+
+	bool simd = texture_compression::simd_enabled();
+	if(!simd) std::cout << "SSE2 kernels not compiled in, only the scalar path is checked" << std::endl;
+
+	bool failed = false;
+	for(auto& image: images)
+		for(auto format: {stylizer::block_format::BC1, stylizer::block_format::BC3, stylizer::block_format::BC5, stylizer::block_format::BC7}) {
+			auto result = texture_compression::benchmark(format, image.view(), iterations);
+			std::cout << format_name(format) << " " << image.name << ": " << result.psnr << " dB, " << result.megapixels_per_second << " MP/s";
+
+			if(result.psnr < minimum_psnr(format)) {
+				std::cout << " [quality below " << minimum_psnr(format) << " dB]";
+				failed = true;
+			}
+			if(result.megapixels_per_second < minimum_throughput) {
+				std::cout << " [throughput below " << minimum_throughput << " MP/s]";
+				failed = true;
+			}
+
+			if(simd) {
+				auto vectorized = texture_compression::compress(format, image.view());
+				texture_compression::set_simd_enabled(false);
+				auto scalar = texture_compression::benchmark(format, image.view(), iterations);
+				auto reference = texture_compression::compress(format, image.view());
+				texture_compression::set_simd_enabled(true);
+
+				std::cout << ", scalar " << scalar.megapixels_per_second << " MP/s";
+				if(vectorized != reference) {
+					std::cout << " [SSE2 and scalar blocks differ]";
+					failed = true;
+				}
+			}
+			std::cout << std::endl;
+		}
+
+	return failed ? 1 : 0;
+}
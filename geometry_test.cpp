@@ -0,0 +1,127 @@
+#include "stylizer/core/geometry.hpp"
+
+#include <iostream>
+#include <random>
+
+// CPU only, checks the mesh optimizer, meshlet builder and LOD selection
+// Usage: stylizer_geometry_test
+
+namespace {
+	struct test_mesh {
+		std::vector<stylizer::float3> positions;
+		std::vector<uint32_t> indices;
+
+		stylizer::mesh_view view() const { return {positions, indices}; }
+	};
+
+	// UV sphere, closed and smooth so simplification isn't held back by borders
+	test_mesh sphere(size_t rings, size_t segments) {
+		constexpr float pi = 3.14159265f;
+		test_mesh out;
+		for(size_t r = 0; r <= rings; ++r)
+			for(size_t s = 0; s < segments; ++s) {
+				float theta = pi * r / rings, phi = 2 * pi * s / segments;
+				out.positions.push_back(stylizer::float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+			}
+		for(size_t r = 0; r < rings; ++r)
+			for(size_t s = 0; s < segments; ++s) {
+				uint32_t a = r * segments + s, b = r * segments + (s + 1) % segments;
+				uint32_t c = a + segments, d = b + segments;
+				if(r != 0) out.indices.insert(out.indices.end(), {a, b, c});
+				if(r != rings - 1) out.indices.insert(out.indices.end(), {b, d, c});
+			}
+		return out;
+	}
+
+	// Triangles rotated so their smallest index comes first, then sorted, winding is preserved
+	std::vector<std::array<uint32_t, 3>> canonical_triangles(std::span<const uint32_t> indices) {
+		std::vector<std::array<uint32_t, 3>> out;
+		for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+			std::array<uint32_t, 3> t = {indices[i], indices[i + 1], indices[i + 2]};
+			std::ranges::rotate(t, std::ranges::min_element(t));
+			out.push_back(t);
+		}
+		std::ranges::sort(out);
+		return out;
+	}
+
+	bool failed = false;
+	void check(bool condition, std::string_view what) {
+		std::cout << (condition ? "ok   " : "FAIL ") << what << std::endl;
+		failed |= !condition;
+	}
+}
+
+int main() {
+	using stylizer::mesh_optimizer;
+	auto mesh = sphere(48, 64);
+	size_t vertex_count = mesh.positions.size();
+
+	{ // Vertex cache optimization should beat a shuffled triangle order
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for(size_t i = 0; i < mesh.indices.size(); i += 3)
+			triangles.push_back({mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]});
+		std::ranges::shuffle(triangles, std::mt19937{1});
+		std::vector<uint32_t> shuffled;
+		for(auto& t: triangles) shuffled.insert(shuffled.end(), t.begin(), t.end());
+
+		auto optimized = mesh_optimizer::optimize_vertex_cache(shuffled, vertex_count);
+		float before = mesh_optimizer::average_cache_miss_ratio(shuffled, vertex_count);
+		float after = mesh_optimizer::average_cache_miss_ratio(optimized, vertex_count);
+		std::cout << "ACMR " << before << " -> " << after << std::endl;
+		check(after < before && after < 1, "optimize_vertex_cache lowers ACMR");
+		check(canonical_triangles(optimized) == canonical_triangles(shuffled), "optimize_vertex_cache keeps every triangle");
+	}
+
+	{ // Without an error limit simplify should reach (but not overshoot by much) the target
+		bool hit = true;
+		for(size_t target: {mesh.indices.size() / 2, mesh.indices.size() / 4, mesh.indices.size() / 10}) {
+			target = target / 3 * 3;
+			float error = 0;
+			auto simplified = mesh_optimizer::simplify(mesh.view(), target, std::numeric_limits<float>::max(), &error);
+			std::cout << "simplify " << mesh.indices.size() << " -> " << simplified.size() << " indices (target " << target << "), error " << error << std::endl;
+			hit &= simplified.size() <= target && simplified.size() >= target * 9 / 10 && simplified.size() % 3 == 0;
+		}
+		check(hit, "simplify hits its target index count");
+
+		float error = 0;
+		auto limited = mesh_optimizer::simplify(mesh.view(), 0, .01f, &error);
+		check(error <= .01f && limited.size() < mesh.indices.size(), "simplify stops at its target error");
+	}
+
+	{ // Every triangle should land in exactly one meshlet, within the limits
+		auto meshlets = stylizer::meshlet_set::build(mesh.view(), 64, 124);
+		std::vector<uint32_t> rebuilt;
+		bool within_limits = meshlets.bounds.size() == meshlets.meshlets.size();
+		for(auto& m: meshlets.meshlets) {
+			within_limits &= m.vertex_count <= 64 && m.triangle_count <= 124;
+			for(size_t i = 0; i < m.triangle_count * 3; ++i)
+				rebuilt.push_back(meshlets.vertices[m.vertex_offset + meshlets.triangles[m.triangle_offset * 3 + i]]);
+		}
+		std::cout << meshlets.meshlets.size() << " meshlets" << std::endl;
+		check(within_limits, "meshlets respect their vertex and triangle limits");
+		check(canonical_triangles(rebuilt) == canonical_triangles(mesh.indices), "meshlets cover every triangle exactly once");
+	}
+
+	{ // Further away should never pick a finer level
+		auto processed = stylizer::processed_mesh::process(mesh.view());
+		bool errors_increase = true;
+		for(size_t i = 1; i < processed->lods.size(); ++i)
+			errors_increase &= processed->lods[i].error >= processed->lods[i - 1].error;
+
+		bool monotonic = true;
+		size_t previous = 0, coarsest = 0;
+		for(float distance = .5f; distance < 1000; distance *= 1.25f) {
+			auto lod = processed->select_lod(distance, 1.f, 1080);
+			monotonic &= lod >= previous;
+			previous = lod;
+			coarsest = std::max(coarsest, lod);
+		}
+		std::cout << processed->lods.size() << " levels, coarsest selected " << coarsest << std::endl;
+		check(processed->lods.size() > 1, "process builds more than one level");
+		check(errors_increase, "level errors never decrease");
+		check(monotonic && coarsest == processed->lods.size() - 1, "select_lod is monotonic in distance");
+	}
+
+	return failed ? 1 : 0;
+}
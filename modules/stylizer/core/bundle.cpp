@@ -0,0 +1,314 @@
+#include "bundle.hpp"
+
+#include <fstream>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace stylizer {
+
+	asset_bundle_writer& asset_bundle_writer::add_shaders(std::string_view name, const shader_processor::compiled_shaders& shaders) {
+		std::vector<std::byte> data;
+		auto append = [&data](std::span<const std::byte> bytes) { data.insert(data.end(), bytes.begin(), bytes.end()); };
+		for(auto& [stage, spirv]: shaders) {
+			uint32_t header[2] = {(uint32_t)stage, (uint32_t)spirv.size()};
+			append(std::as_bytes(std::span{header}));
+			append(std::as_bytes(std::span{spirv}));
+		}
+		return add(name, asset_type::Shader, data, {(uint32_t)shaders.size()});
+	}
+
+	asset_bundle_writer& asset_bundle_writer::add_mesh(std::string_view name, std::span<const std::byte> vertices, size_t vertex_stride, std::span<const uint32_t> indices) {
+		assert(vertex_stride > 0 && vertices.size() % vertex_stride == 0);
+		auto index_offset = (vertices.size() + 3) / 4 * 4;
+		std::vector<std::byte> data(index_offset + indices.size_bytes());
+		std::memcpy(data.data(), vertices.data(), vertices.size());
+		std::memcpy(data.data() + index_offset, indices.data(), indices.size_bytes());
+		return add(name, asset_type::Mesh, data, {uint32_t(vertices.size() / vertex_stride), (uint32_t)vertex_stride, (uint32_t)indices.size(), (uint32_t)index_offset});
+	}
+
+	asset_bundle_writer& asset_bundle_writer::add_texture(std::string_view name, const compressed_image& image) {
+		std::vector<std::byte> data;
+		for(auto& mip: image.mips) data.insert(data.end(), mip.begin(), mip.end());
+		return add(name, asset_type::Texture, data, {(uint32_t)image.format, image.size.x, image.size.y, (uint32_t)image.mips.size()});
+	}
+
+	bool asset_bundle_writer::save(const std::filesystem::path& path) const {
+		assert(blob_alignment > 0);
+		auto align = [this](uint64_t offset) { return (offset + blob_alignment - 1) / blob_alignment * blob_alignment; };
+
+		std::vector<const pending*> sorted;
+		for(auto& asset: assets) sorted.push_back(&asset);
+		std::ranges::sort(sorted, {}, [](const pending* a) { return hash_bytes(a->name); });
+
+		std::string names;
+		for(auto asset: sorted) names += asset->name;
+
+		asset_bundle_header header = {
+			.magic = magic,
+			.version = version,
+			.entry_count = (uint32_t)sorted.size(),
+			.names_offset = sizeof(asset_bundle_header) + sorted.size() * sizeof(asset_bundle_entry),
+			.names_size = names.size(),
+			.blob_alignment = blob_alignment
+		};
+
+		// Lay out the blobs, sharing storage between assets with identical contents
+		std::vector<asset_bundle_entry> entries;
+		std::vector<const pending*> blobs; // Unique blobs in file order
+		std::unordered_multimap<uint64_t, std::pair<const pending*, uint64_t>> stored; // Content hash -> (blob, offset)
+		uint64_t end = header.names_offset + header.names_size;
+		uint32_t name_offset = 0;
+		for(auto asset: sorted) {
+			// The hash only finds candidates, storage is shared once the bytes actually match
+			auto content_hash = hash_bytes(asset->data);
+			auto [first, last] = stored.equal_range(content_hash);
+			auto found = std::ranges::find_if(first, last, [asset](auto& candidate) { return std::ranges::equal(candidate.second.first->data, asset->data); });
+			uint64_t offset;
+			if(found != last) offset = found->second.second;
+			else {
+				offset = align(end);
+				end = offset + asset->data.size();
+				blobs.push_back(asset);
+				stored.emplace(content_hash, std::pair{asset, offset});
+			}
+
+			entries.push_back({
+				.name_hash = hash_bytes(asset->name),
+				.name_offset = name_offset,
+				.name_size = (uint32_t)asset->name.size(),
+				.type = asset->type,
+				.offset = offset,
+				.size = asset->data.size(),
+				.content_hash = content_hash,
+				.metadata = asset->metadata
+			});
+			name_offset += asset->name.size();
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if(!file) return false;
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(), entries.size() * sizeof(asset_bundle_entry));
+		file.write(names.data(), names.size());
+
+		std::vector<char> padding;
+		uint64_t position = header.names_offset + header.names_size;
+		for(auto blob: blobs) {
+			padding.assign(align(position) - position, 0);
+			file.write(padding.data(), padding.size());
+			file.write((const char*)blob->data.data(), blob->data.size());
+			position = align(position) + blob->data.size();
+		}
+		return file.good();
+	}
+
+	optional<asset_bundle> asset_bundle::open(const std::filesystem::path& path, create_config config /* = {} */) {
+		asset_bundle out;
+		out.config = config;
+#ifdef _WIN32
+		auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if(file == INVALID_HANDLE_VALUE) return {};
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) { CloseHandle(file); return {}; }
+		auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(!mapping) { CloseHandle(file); return {}; }
+		out.mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if(!out.mapping) { CloseHandle(mapping); CloseHandle(file); return {}; }
+		out.file_handle = file;
+		out.mapping_handle = mapping;
+		out.mapping_size = size.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if(file < 0) return {};
+		struct stat info;
+		if(fstat(file, &info) != 0 || info.st_size == 0) { ::close(file); return {}; }
+		auto mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file); // The mapping keeps the file alive
+		if(mapping == MAP_FAILED) return {};
+		// Assets are scattered through the file, don't read ahead past the one being touched
+		madvise(mapping, info.st_size, MADV_RANDOM);
+		out.mapping = mapping;
+		out.mapping_size = info.st_size;
+#endif
+		out.data = {(const std::byte*)out.mapping, out.mapping_size};
+
+		// Validate the header and index, only they are touched until an asset is used
+		auto fail = [&out]() -> optional<asset_bundle> { out.release(); return {}; };
+		if(out.data.size() < sizeof(asset_bundle_header)) return fail();
+		asset_bundle_header header;
+		std::memcpy(&header, out.data.data(), sizeof(header));
+		if(header.magic != asset_bundle_writer::magic || header.version != asset_bundle_writer::version) return fail();
+		if(sizeof(header) + uint64_t(header.entry_count) * sizeof(asset_bundle_entry) > out.data.size()) return fail();
+		if(header.names_offset > out.data.size() || header.names_size > out.data.size() - header.names_offset) return fail();
+
+		out.entries = {(const asset_bundle_entry*)(out.data.data() + sizeof(header)), header.entry_count};
+		out.names = {(const char*)out.data.data() + header.names_offset, header.names_size};
+		for(auto& entry: out.entries)
+			if(entry.offset > out.data.size() || entry.size > out.data.size() - entry.offset || uint64_t(entry.name_offset) + entry.name_size > out.names.size())
+				return fail();
+		// find() binary searches the index
+		if(!std::ranges::is_sorted(out.entries, {}, &asset_bundle_entry::name_hash)) return fail();
+		return out;
+	}
+
+	void asset_bundle::prefetch(const asset_bundle_entry& entry) const {
+		if(!mapping || entry.size == 0) return;
+#ifdef _WIN32
+		WIN32_MEMORY_RANGE_ENTRY range = {(void*)(data.data() + entry.offset), entry.size};
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+		auto page = (uint64_t)sysconf(_SC_PAGESIZE);
+		auto start = entry.offset / page * page;
+		madvise((char*)mapping + start, entry.offset + entry.size - start, MADV_WILLNEED);
+#endif
+	}
+
+	void asset_bundle::evict(const asset_bundle_entry& entry) const {
+		if(!mapping || entry.size == 0) return;
+#ifdef _WIN32
+		// Unlocking pages which were never locked removes them from the working set
+		VirtualUnlock((void*)(data.data() + entry.offset), entry.size);
+#else
+		// Only whole pages inside the blob, neighbouring assets may share the edge pages
+		auto page = (uint64_t)sysconf(_SC_PAGESIZE);
+		auto start = (entry.offset + page - 1) / page * page, end = (entry.offset + entry.size) / page * page;
+		if(end > start) madvise((char*)mapping + start, end - start, MADV_DONTNEED);
+#endif
+	}
+
+	std::span<const std::byte> asset_bundle::use(const asset_bundle_entry& entry) const {
+		prefetch(entry);
+		if(config.verify_hashes && !verify(entry))
+			throw hash_mismatch("Asset bundle entry is corrupt: " + std::string{name(entry)});
+		return blob(entry);
+	}
+
+	std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> asset_bundle::create_shaders(context& ctx, std::string_view name, optional<std::span<const shader_processor::vertex_buffer_layout>> validate_against /* = {} */) {
+		auto& entry = at(name);
+		assert(entry.type == asset_type::Shader);
+		auto blob = use(entry);
+
+		std::vector<managable<STYLIZER_API_TYPE(shader)>> shaders; shaders.reserve(entry.metadata[0]);
+		api::pipeline::entry_points eps;
+		size_t offset = 0;
+		for(size_t i = 0; i < entry.metadata[0]; ++i) {
+			if(offset + 2 * sizeof(uint32_t) > blob.size()) throw std::out_of_range("Truncated shader asset: " + std::string{name});
+			auto header = (const uint32_t*)(blob.data() + offset);
+			auto stage = (api::shader::stage)header[0];
+			offset += 2 * sizeof(uint32_t);
+			if(offset + size_t(header[1]) * sizeof(uint32_t) > blob.size()) throw std::out_of_range("Truncated shader asset: " + std::string{name});
+			std::span<const uint32_t> spirv = {(const uint32_t*)(blob.data() + offset), header[1]}; // Blobs are page aligned
+			offset += spirv.size_bytes();
+
+			if(validate_against && stage == api::shader::stage::Vertex)
+				shader_processor::validate_vertex_inputs(spirv, *validate_against);
+			shaders.emplace_back(true, ctx.device.create_shader_from_spirv(spirv));
+			eps.emplace(stage, api::pipeline::entry_point{.shader = &shaders.back().value});
+		}
+		done_with(entry);
+		return {std::move(shaders), eps};
+	}
+
+	material asset_bundle::create_material_for_geometry_buffer(context& ctx, std::string_view name, geometry_buffer& gbuffer, const api::render_pipeline::config& config /* = {} */) {
+		auto [shaders, eps] = create_shaders(ctx, name, std::span<const shader_processor::vertex_buffer_layout>{config.vertex_buffers});
+		material out{};
+		out.shaders = std::move(shaders);
+		out.upload_from_shaders_for_geometry_buffer(ctx, eps, gbuffer, config);
+		return out;
+	}
+
+	asset_bundle::mesh asset_bundle::create_mesh(context& ctx, std::string_view name) {
+		using namespace api::operators;
+		auto& entry = at(name);
+		assert(entry.type == asset_type::Mesh);
+		use(entry);
+		auto vertices = mesh_vertices(entry);
+		auto indices = std::as_bytes(mesh_indices(entry));
+		if((vertices.size() + 3) / 4 * 4 > entry.size) throw std::out_of_range("Truncated mesh asset: " + std::string{name});
+
+		mesh out;
+		out.vertex_count = entry.metadata[0];
+		out.vertex_stride = entry.metadata[1];
+		out.index_count = entry.metadata[2];
+		out.vertices = ctx.create_buffer({
+			.label = "Stylizer Bundle Vertex Buffer",
+			.usage = api::usage::Vertex | api::usage::CopyDestination,
+			.size = (vertices.size() + 3) / 4 * 4 // Writes must be 4 byte multiples, the blob is padded to cover it
+		}, "mesh");
+		out.indices = ctx.create_buffer({
+			.label = "Stylizer Bundle Index Buffer",
+			.usage = api::usage::Index | api::usage::CopyDestination,
+			.size = indices.size()
+		}, "mesh");
+		out.vertices.write(ctx, blob(entry).subspan(0, (vertices.size() + 3) / 4 * 4));
+		out.indices.write(ctx, indices);
+		done_with(entry);
+		return out;
+	}
+
+	tracked<texture> asset_bundle::create_texture(context& ctx, std::string_view name, texture_compression::create_config config /* = {} */) {
+		auto& entry = at(name);
+		assert(entry.type == asset_type::Texture);
+		auto blob = use(entry);
+
+		auto format = (block_format)entry.metadata[0];
+		uint2 size = {entry.metadata[1], entry.metadata[2]};
+		std::vector<std::span<const std::byte>> mips;
+		size_t offset = 0;
+		for(size_t level = 0; level < entry.metadata[3]; ++level) {
+			auto bytes = texture_compression::compressed_size(format, {std::max(size.x >> level, 1u), std::max(size.y >> level, 1u)});
+			if(offset + bytes > blob.size()) throw std::out_of_range("Truncated texture asset: " + std::string{name});
+			mips.push_back(blob.subspan(offset, bytes));
+			offset += bytes;
+		}
+
+		config.label = this->name(entry);
+		auto out = texture_compression::create_texture(ctx, format, size, mips, config);
+		done_with(entry);
+		return out;
+	}
+
+	asset_bundle& asset_bundle::operator=(asset_bundle&& o) {
+		if(this == &o) return *this;
+		release();
+		data = std::exchange(o.data, {});
+		entries = std::exchange(o.entries, {});
+		names = std::exchange(o.names, {});
+		config = o.config;
+		mapping = std::exchange(o.mapping, nullptr);
+		mapping_size = std::exchange(o.mapping_size, 0);
+#ifdef _WIN32
+		file_handle = std::exchange(o.file_handle, nullptr);
+		mapping_handle = std::exchange(o.mapping_handle, nullptr);
+#endif
+		return *this;
+	}
+
+	void asset_bundle::release() {
+		if(mapping) {
+#ifdef _WIN32
+			UnmapViewOfFile(mapping);
+			if(mapping_handle) CloseHandle(mapping_handle);
+			if(file_handle) CloseHandle(file_handle);
+			mapping_handle = file_handle = nullptr;
+#else
+			munmap(mapping, mapping_size);
+#endif
+		}
+		mapping = nullptr;
+		mapping_size = 0;
+		data = {};
+		entries = {};
+		names = {};
+	}
+
+} // namespace stylizer
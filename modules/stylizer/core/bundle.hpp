@@ -0,0 +1,165 @@
+#pragma once
+
+#include "compression.hpp"
+
+namespace stylizer {
+
+//////////////////////////////////////////////////////////////////////
+// # Asset Bundle
+//////////////////////////////////////////////////////////////////////
+
+
+	// File layout: header, index (sorted by name hash), name table, then every blob aligned to blob_alignment
+	enum class asset_type : uint32_t {
+		Raw,
+		Shader, // Per stage: stage, word count, SPIR-V words
+		Mesh, // Vertices in their GPU layout, then 32 bit indices (4 byte aligned)
+		Texture, // Block compressed mips, largest first
+	};
+
+	struct asset_bundle_header {
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t entry_count;
+		uint64_t names_offset, names_size;
+		uint32_t blob_alignment;
+		uint32_t reserved = 0;
+	};
+	static_assert(sizeof(asset_bundle_header) == 40);
+
+	struct asset_bundle_entry {
+		uint64_t name_hash;
+		uint32_t name_offset, name_size; // Into the name table
+		asset_type type;
+		uint32_t reserved = 0;
+		uint64_t offset, size;
+		uint64_t content_hash; // hash_bytes of the blob
+		// Shader: stage count | Mesh: vertex count, vertex stride, index count, index offset | Texture: block format, width, height, mip count
+		std::array<uint32_t, 4> metadata = {};
+	};
+	static_assert(sizeof(asset_bundle_entry) == 64);
+
+	// Builds bundles offline (or at import time), assets are copied in until save
+	struct asset_bundle_writer {
+		static constexpr std::array<char, 8> magic = {'S', 'T', 'Y', 'L', 'B', 'N', 'D', 'L'};
+		static constexpr uint32_t version = 1;
+
+		struct pending {
+			std::string name;
+			asset_type type;
+			std::array<uint32_t, 4> metadata;
+			std::vector<std::byte> data;
+		};
+
+		std::vector<pending> assets;
+		uint32_t blob_alignment = 4096; // Page aligned so each blob can be paged in and out on its own
+
+		asset_bundle_writer& add(std::string_view name, asset_type type, std::span<const std::byte> data, std::array<uint32_t, 4> metadata = {}) {
+			assets.push_back({std::string{name}, type, metadata, {data.begin(), data.end()}});
+			return *this;
+		}
+		asset_bundle_writer& add_shaders(std::string_view name, const shader_processor::compiled_shaders& shaders);
+		asset_bundle_writer& add_mesh(std::string_view name, std::span<const std::byte> vertices, size_t vertex_stride, std::span<const uint32_t> indices);
+		template<typename V>
+		asset_bundle_writer& add_mesh(std::string_view name, std::span<const V> vertices, std::span<const uint32_t> indices) {
+			return add_mesh(name, std::as_bytes(vertices), sizeof(V), indices);
+		}
+		asset_bundle_writer& add_texture(std::string_view name, const compressed_image& image);
+
+		// Identical blobs are only stored once
+		bool save(const std::filesystem::path& path) const;
+	};
+
+	struct asset_bundle_create_config {
+		bool verify_hashes = false; // Hash every blob as it is used, this touches every page of it
+		bool evict_after_upload = true; // Drop an asset's pages once the GPU has its own copy
+	};
+
+	// Read only memory mapping of a bundle, assets are uploaded straight from the mapped pages
+	// which the OS only reads in once they are touched
+	struct asset_bundle {
+		using create_config = asset_bundle_create_config;
+
+		struct mesh {
+			tracked<STYLIZER_API_TYPE(buffer)> vertices, indices;
+			size_t vertex_count = 0, vertex_stride = 0, index_count = 0;
+
+			operator bool() const { return vertices; }
+			void release() {
+				vertices.release(); indices.release();
+			}
+		};
+
+		struct hash_mismatch : public std::runtime_error {
+			using std::runtime_error::runtime_error;
+		};
+
+		std::span<const std::byte> data; // The whole file
+		std::span<const asset_bundle_entry> entries;
+		std::string_view names;
+		create_config config;
+
+		// Owns the mapping, so it can only be moved
+		asset_bundle() {}
+		asset_bundle(const asset_bundle&) = delete;
+		asset_bundle(asset_bundle&& o) { *this = std::move(o); }
+		asset_bundle& operator=(const asset_bundle&) = delete;
+		asset_bundle& operator=(asset_bundle&& o);
+
+		static optional<asset_bundle> open(const std::filesystem::path& path, create_config config = {});
+
+		operator bool() const { return !data.empty(); }
+
+		const asset_bundle_entry* find(std::string_view name) const {
+			auto hash = hash_bytes(name);
+			auto [first, last] = std::ranges::equal_range(entries, hash, {}, &asset_bundle_entry::name_hash);
+			for(auto& entry: std::ranges::subrange(first, last))
+				if(this->name(entry) == name) return &entry;
+			return nullptr;
+		}
+		const asset_bundle_entry& at(std::string_view name) const {
+			auto out = find(name);
+			if(!out) throw std::out_of_range("Asset not found in bundle: " + std::string{name});
+			return *out;
+		}
+		std::string_view name(const asset_bundle_entry& entry) const { return names.substr(entry.name_offset, entry.name_size); }
+		std::span<const std::byte> blob(const asset_bundle_entry& entry) const { return data.subspan(entry.offset, entry.size); }
+		bool verify(const asset_bundle_entry& entry) const { return hash_bytes(blob(entry)) == entry.content_hash; }
+
+		// Hints that an asset is about to be used (read ahead) or won't be for a while (drop its pages)
+		void prefetch(const asset_bundle_entry& entry) const;
+		void evict(const asset_bundle_entry& entry) const;
+
+		std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> create_shaders(context& ctx, std::string_view name, optional<std::span<const shader_processor::vertex_buffer_layout>> validate_against = {});
+		material create_material_for_geometry_buffer(context& ctx, std::string_view name, geometry_buffer& gbuffer, const api::render_pipeline::config& config = {});
+		mesh create_mesh(context& ctx, std::string_view name);
+		// CPU side views of a mesh asset (ex. for collision), these touch its pages
+		std::span<const std::byte> mesh_vertices(const asset_bundle_entry& entry) const {
+			auto bytes = uint64_t(entry.metadata[0]) * entry.metadata[1];
+			if(bytes > entry.size) throw std::out_of_range("Truncated mesh asset: " + std::string{name(entry)});
+			return blob(entry).subspan(0, bytes);
+		}
+		std::span<const uint32_t> mesh_indices(const asset_bundle_entry& entry) const {
+			if(entry.metadata[3] % alignof(uint32_t) || entry.metadata[3] + uint64_t(entry.metadata[2]) * sizeof(uint32_t) > entry.size)
+				throw std::out_of_range("Truncated mesh asset: " + std::string{name(entry)});
+			auto bytes = blob(entry).subspan(entry.metadata[3], size_t(entry.metadata[2]) * sizeof(uint32_t));
+			return {(const uint32_t*)bytes.data(), entry.metadata[2]};
+		}
+		tracked<texture> create_texture(context& ctx, std::string_view name, texture_compression::create_config config = {});
+
+		void release();
+
+	protected:
+		void* mapping = nullptr;
+		size_t mapping_size = 0;
+#ifdef _WIN32
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#endif
+
+		// Verifies (if configured) and prefetches an asset before it is read
+		std::span<const std::byte> use(const asset_bundle_entry& entry) const;
+		void done_with(const asset_bundle_entry& entry) const { if(config.evict_after_upload) evict(entry); }
+	};
+
+} // namespace stylizer
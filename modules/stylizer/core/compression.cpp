@@ -0,0 +1,686 @@
+#include "compression.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define STYLIZER_COMPRESSION_SSE2
+#endif
+
+namespace stylizer {
+
+	namespace {
+		using pixel_block = std::array<uint8_t, 16 * 4>; // 4x4 RGBA
+
+		std::atomic<bool> simd = true; // See texture_compression::set_simd_enabled
+
+		pixel_block load_block(const image_view& image, size_t block_x, size_t block_y) {
+			pixel_block out;
+			auto stride = image.stride();
+			for(size_t y = 0; y < 4; ++y) {
+				// Edge blocks repeat the last row/column
+				auto row = std::min<size_t>(block_y * 4 + y, image.size.y - 1);
+				for(size_t x = 0; x < 4; ++x) {
+					auto column = std::min<size_t>(block_x * 4 + x, image.size.x - 1);
+					std::memcpy(out.data() + (y * 4 + x) * 4, image.pixels.data() + row * stride + column * 4, 4);
+				}
+			}
+			return out;
+		}
+
+		void block_bounds(const pixel_block& block, uint8_t min[4], uint8_t max[4]) {
+#ifdef STYLIZER_COMPRESSION_SSE2
+			if(simd.load(std::memory_order_relaxed)) {
+				auto a = _mm_loadu_si128((const __m128i*)block.data());
+				auto b = _mm_loadu_si128((const __m128i*)block.data() + 1);
+				auto c = _mm_loadu_si128((const __m128i*)block.data() + 2);
+				auto d = _mm_loadu_si128((const __m128i*)block.data() + 3);
+				auto low = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+				auto high = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+				// Fold the 4 pixels in each register down to one
+				low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+				low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+				high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+				high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+				uint32_t packed_min = _mm_cvtsi128_si32(low), packed_max = _mm_cvtsi128_si32(high);
+				std::memcpy(min, &packed_min, 4);
+				std::memcpy(max, &packed_max, 4);
+				return;
+			}
+#endif
+			for(size_t c = 0; c < 4; ++c) {
+				min[c] = 255; max[c] = 0;
+			}
+			for(size_t i = 0; i < 16; ++i)
+				for(size_t c = 0; c < 4; ++c) {
+					min[c] = std::min(min[c], block[i * 4 + c]);
+					max[c] = std::max(max[c], block[i * 4 + c]);
+				}
+		}
+
+		// Sum of squared differences of the first `channels` channels of two RGBA pixels
+		int distance(const uint8_t* a, const uint8_t* b, size_t channels) {
+			int out = 0;
+			for(size_t c = 0; c < channels; ++c) {
+				int d = int(a[c]) - int(b[c]);
+				out += d * d;
+			}
+			return out;
+		}
+
+		// Picks the closest palette entry (over the first `channels` channels) for every pixel of the block, returns the summed squared error
+		// NOTE: Ties go to the lowest palette index on both paths so the output is identical with and without SSE2
+		int nearest_indices(const pixel_block& block, const std::array<uint8_t, 4>* palette, size_t palette_size, size_t channels, uint8_t indices[16]) {
+#ifdef STYLIZER_COMPRESSION_SSE2
+			if(simd.load(std::memory_order_relaxed)) {
+				auto zero = _mm_setzero_si128();
+				int16_t masks[8];
+				for(size_t c = 0; c < 8; ++c) masks[c] = c % 4 < channels ? -1 : 0;
+				auto mask = _mm_loadu_si128((const __m128i*)masks);
+
+				// Four pixels per register, each lane holds one pixel's distance
+				__m128i best_distance[4], best_index[4];
+				for(size_t p = 0; p < palette_size; ++p) {
+					uint32_t packed;
+					std::memcpy(&packed, palette[p].data(), 4);
+					auto color = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+					color = _mm_unpacklo_epi64(color, color); // 16 bit RGBA RGBA
+					auto index = _mm_set1_epi32(p);
+
+					for(size_t group = 0; group < 4; ++group) {
+						auto pixels = _mm_loadu_si128((const __m128i*)block.data() + group);
+						auto low = _mm_and_si128(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), color), mask);
+						auto high = _mm_and_si128(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), color), mask);
+						low = _mm_madd_epi16(low, low); // (r² + g², b² + a²) for two pixels
+						high = _mm_madd_epi16(high, high);
+						auto rg = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+						auto ba = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+						auto distance = _mm_add_epi32(rg, ba);
+
+						if(p == 0) {
+							best_distance[group] = distance;
+							best_index[group] = index;
+							continue;
+						}
+						auto closer = _mm_cmplt_epi32(distance, best_distance[group]);
+						best_distance[group] = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best_distance[group]));
+						best_index[group] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_index[group]));
+					}
+				}
+
+				auto error = _mm_add_epi32(_mm_add_epi32(best_distance[0], best_distance[1]), _mm_add_epi32(best_distance[2], best_distance[3]));
+				error = _mm_add_epi32(error, _mm_srli_si128(error, 8));
+				error = _mm_add_epi32(error, _mm_srli_si128(error, 4));
+				// Narrow the 32 bit indices down to bytes
+				auto packed = _mm_packus_epi16(_mm_packs_epi32(best_index[0], best_index[1]), _mm_packs_epi32(best_index[2], best_index[3]));
+				_mm_storeu_si128((__m128i*)indices, packed);
+				return _mm_cvtsi128_si32(error);
+			}
+#endif
+			int error = 0;
+			for(size_t i = 0; i < 16; ++i) {
+				int best_distance = std::numeric_limits<int>::max();
+				for(size_t p = 0; p < palette_size; ++p)
+					if(auto d = distance(block.data() + i * 4, palette[p].data(), channels); d < best_distance) {
+						indices[i] = p;
+						best_distance = d;
+					}
+				error += best_distance;
+			}
+			return error;
+		}
+
+		// Fits a line through the block's colors (principal axis by power iteration) and returns its
+		// extents slightly inset, this handles anti-correlated channels which a bounding box can't
+		void line_endpoints(const pixel_block& block, size_t channels, float e0[4], float e1[4]) {
+			uint8_t min[4], max[4];
+			block_bounds(block, min, max);
+
+			float mean[4] = {};
+			for(size_t i = 0; i < 16; ++i)
+				for(size_t c = 0; c < channels; ++c)
+					mean[c] += block[i * 4 + c] / 16.f;
+
+			float covariance[4][4] = {};
+			for(size_t i = 0; i < 16; ++i)
+				for(size_t a = 0; a < channels; ++a)
+					for(size_t b = a; b < channels; ++b)
+						covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+			for(size_t a = 0; a < channels; ++a)
+				for(size_t b = 0; b < a; ++b)
+					covariance[a][b] = covariance[b][a];
+
+			float axis[4] = {};
+			for(size_t c = 0; c < channels; ++c) axis[c] = float(max[c]) - min[c];
+			for(size_t iteration = 0; iteration < 8; ++iteration) {
+				float next[4] = {}, length = 0;
+				for(size_t a = 0; a < channels; ++a) {
+					for(size_t b = 0; b < channels; ++b)
+						next[a] += covariance[a][b] * axis[b];
+					length = std::max(length, std::abs(next[a]));
+				}
+				if(length == 0) break;
+				for(size_t c = 0; c < channels; ++c) axis[c] = next[c] / length;
+			}
+
+			float length_squared = 0;
+			for(size_t c = 0; c < channels; ++c) length_squared += axis[c] * axis[c];
+			if(length_squared == 0) { // Flat block
+				for(size_t c = 0; c < 4; ++c) e0[c] = e1[c] = c < channels ? mean[c] : 0;
+				return;
+			}
+
+			float low = std::numeric_limits<float>::max(), high = std::numeric_limits<float>::lowest();
+			for(size_t i = 0; i < 16; ++i) {
+				float projection = 0;
+				for(size_t c = 0; c < channels; ++c)
+					projection += (block[i * 4 + c] - mean[c]) * axis[c];
+				low = std::min(low, projection);
+				high = std::max(high, projection);
+			}
+			low /= length_squared; high /= length_squared;
+			float inset = (high - low) / 32;
+			low += inset; high -= inset;
+
+			for(size_t c = 0; c < 4; ++c) {
+				e0[c] = c < channels ? std::clamp(mean[c] + axis[c] * high, 0.f, 255.f) : 0;
+				e1[c] = c < channels ? std::clamp(mean[c] + axis[c] * low, 0.f, 255.f) : 0;
+			}
+		}
+
+		uint16_t to_565(const float color[4]) {
+			auto r = uint16_t(std::lround(color[0] * 31 / 255)), g = uint16_t(std::lround(color[1] * 63 / 255)), b = uint16_t(std::lround(color[2] * 31 / 255));
+			return (r << 11) | (g << 5) | b;
+		}
+		std::array<uint8_t, 4> from_565(uint16_t color) {
+			uint8_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+			return {uint8_t((r << 3) | (r >> 2)), uint8_t((g << 2) | (g >> 4)), uint8_t((b << 3) | (b >> 2)), 255};
+		}
+
+		std::array<std::array<uint8_t, 4>, 4> bc1_palette(uint16_t c0, uint16_t c1, bool four_color) {
+			std::array<std::array<uint8_t, 4>, 4> out;
+			out[0] = from_565(c0);
+			out[1] = from_565(c1);
+			for(size_t c = 0; c < 4; ++c)
+				if(four_color) {
+					out[2][c] = (2 * out[0][c] + out[1][c]) / 3;
+					out[3][c] = (out[0][c] + 2 * out[1][c]) / 3;
+				} else {
+					out[2][c] = (out[0][c] + out[1][c]) / 2;
+					out[3][c] = 0;
+				}
+			if(!four_color) out[3][3] = 0;
+			return out;
+		}
+
+		void encode_bc1(const pixel_block& block, std::byte* out) {
+			float e0[4], e1[4];
+			line_endpoints(block, 3, e0, e1);
+			uint16_t c0 = to_565(e0), c1 = to_565(e1);
+			if(c0 < c1) std::swap(c0, c1); // c0 > c1 selects the four color mode
+
+			uint32_t indices = 0;
+			if(c0 != c1) {
+				auto palette = bc1_palette(c0, c1, true);
+				uint8_t best[16];
+				nearest_indices(block, palette.data(), palette.size(), 3, best);
+				for(size_t i = 0; i < 16; ++i)
+					indices |= uint32_t(best[i]) << (i * 2);
+			}
+
+			std::memcpy(out, &c0, 2);
+			std::memcpy(out + 2, &c1, 2);
+			std::memcpy(out + 4, &indices, 4);
+		}
+
+		std::array<uint8_t, 8> bc4_palette(uint8_t a0, uint8_t a1) {
+			std::array<uint8_t, 8> out = {a0, a1};
+			if(a0 > a1)
+				for(size_t i = 1; i < 7; ++i)
+					out[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+			else {
+				for(size_t i = 1; i < 5; ++i)
+					out[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+				out[6] = 0; out[7] = 255;
+			}
+			return out;
+		}
+
+		void encode_bc4(const pixel_block& block, size_t channel, std::byte* out) {
+			uint8_t min[4], max[4];
+			block_bounds(block, min, max);
+			uint8_t a0 = max[channel], a1 = min[channel];
+
+			uint64_t bits = uint64_t(a0) | (uint64_t(a1) << 8);
+			if(a0 != a1) {
+				auto palette = bc4_palette(a0, a1);
+				for(size_t i = 0; i < 16; ++i) {
+					uint64_t best = 0;
+					int best_distance = std::numeric_limits<int>::max();
+					for(uint64_t p = 0; p < 8; ++p)
+						if(int d = std::abs(int(block[i * 4 + channel]) - palette[p]); d < best_distance) {
+							best = p;
+							best_distance = d;
+						}
+					bits |= best << (16 + i * 3);
+				}
+			}
+			std::memcpy(out, &bits, 8);
+		}
+
+		// ## BC7
+
+		constexpr std::array<uint8_t, 16> bc7_weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+		struct bit_writer {
+			std::byte* out;
+			size_t offset = 0;
+			void write(uint32_t value, size_t bits) {
+				for(size_t i = 0; i < bits; ++i, ++offset)
+					if(value & (1u << i))
+						out[offset / 8] |= std::byte(1 << (offset % 8));
+			}
+		};
+		struct bit_reader {
+			const std::byte* in;
+			size_t offset = 0;
+			uint32_t read(size_t bits) {
+				uint32_t out = 0;
+				for(size_t i = 0; i < bits; ++i, ++offset)
+					out |= uint32_t((std::to_integer<uint8_t>(in[offset / 8]) >> (offset % 8)) & 1) << i;
+				return out;
+			}
+		};
+
+		// Mode 6: one subset, 7 bit RGBA endpoints with a shared LSB (p bit) each, 4 bit indices
+		void encode_bc7(const pixel_block& block, std::byte* out) {
+			float e0[4], e1[4];
+			line_endpoints(block, 4, e0, e1);
+
+			std::array<uint8_t, 4> best_q0, best_q1;
+			std::array<uint8_t, 16> best_indices;
+			uint32_t best_p0 = 0, best_p1 = 0;
+			int best_error = std::numeric_limits<int>::max();
+			for(uint32_t p0 = 0; p0 < 2; ++p0)
+				for(uint32_t p1 = 0; p1 < 2; ++p1) {
+					std::array<uint8_t, 4> q0, q1;
+					std::array<std::array<uint8_t, 4>, 16> palette;
+					for(size_t c = 0; c < 4; ++c) {
+						q0[c] = std::clamp<int>(std::lround((e0[c] - p0) / 2), 0, 127);
+						q1[c] = std::clamp<int>(std::lround((e1[c] - p1) / 2), 0, 127);
+					}
+					for(size_t w = 0; w < 16; ++w)
+						for(size_t c = 0; c < 4; ++c) {
+							int a = (q0[c] << 1) | p0, b = (q1[c] << 1) | p1;
+							palette[w][c] = ((64 - bc7_weights[w]) * a + bc7_weights[w] * b + 32) >> 6;
+						}
+
+					std::array<uint8_t, 16> indices;
+					int error = nearest_indices(block, palette.data(), palette.size(), 4, indices.data());
+
+					if(error < best_error) {
+						best_error = error;
+						best_q0 = q0; best_q1 = q1;
+						best_p0 = p0; best_p1 = p1;
+						best_indices = indices;
+					}
+				}
+
+			// The first index's top bit is implied zero, flip the line if it isn't
+			if(best_indices[0] & 8) {
+				std::swap(best_q0, best_q1);
+				std::swap(best_p0, best_p1);
+				for(auto& index: best_indices) index = 15 - index;
+			}
+
+			std::memset(out, 0, 16);
+			bit_writer writer{out};
+			writer.write(1 << 6, 7); // Mode 6
+			for(size_t c = 0; c < 4; ++c) {
+				writer.write(best_q0[c], 7);
+				writer.write(best_q1[c], 7);
+			}
+			writer.write(best_p0, 1);
+			writer.write(best_p1, 1);
+			for(size_t i = 0; i < 16; ++i)
+				writer.write(best_indices[i], i == 0 ? 3 : 4);
+		}
+
+		void encode_block(block_format format, const pixel_block& block, std::byte* out) {
+			switch(format) {
+				case block_format::BC1: encode_bc1(block, out); break;
+				case block_format::BC3: encode_bc4(block, 3, out); encode_bc1(block, out + 8); break;
+				case block_format::BC5: encode_bc4(block, 0, out); encode_bc4(block, 1, out + 8); break;
+				case block_format::BC7: encode_bc7(block, out); break;
+			}
+		}
+
+		void decode_bc1(const std::byte* in, bool force_four_color, uint8_t* out /* 16 RGBA pixels */) {
+			uint16_t c0, c1; uint32_t indices;
+			std::memcpy(&c0, in, 2);
+			std::memcpy(&c1, in + 2, 2);
+			std::memcpy(&indices, in + 4, 4);
+			auto palette = bc1_palette(c0, c1, force_four_color || c0 > c1);
+			for(size_t i = 0; i < 16; ++i)
+				std::memcpy(out + i * 4, palette[(indices >> (i * 2)) & 3].data(), 4);
+		}
+
+		void decode_bc4(const std::byte* in, size_t channel, uint8_t* out /* 16 RGBA pixels */) {
+			uint64_t bits;
+			std::memcpy(&bits, in, 8);
+			auto palette = bc4_palette(bits & 0xFF, (bits >> 8) & 0xFF);
+			for(size_t i = 0; i < 16; ++i)
+				out[i * 4 + channel] = palette[(bits >> (16 + i * 3)) & 7];
+		}
+
+		void decode_bc7(const std::byte* in, uint8_t* out /* 16 RGBA pixels */) {
+			bit_reader reader{in};
+			if(reader.read(7) != 1 << 6) { // Only mode 6 is produced by the encoder
+				std::memset(out, 0, 64);
+				return;
+			}
+			uint32_t q0[4], q1[4];
+			for(size_t c = 0; c < 4; ++c) {
+				q0[c] = reader.read(7);
+				q1[c] = reader.read(7);
+			}
+			auto p0 = reader.read(1), p1 = reader.read(1);
+			for(size_t i = 0; i < 16; ++i) {
+				auto w = bc7_weights[reader.read(i == 0 ? 3 : 4)];
+				for(size_t c = 0; c < 4; ++c) {
+					uint32_t a = (q0[c] << 1) | p0, b = (q1[c] << 1) | p1;
+					out[i * 4 + c] = ((64 - w) * a + w * b + 32) >> 6;
+				}
+			}
+		}
+
+		std::vector<std::byte> downsample(const image_view& image) {
+			uint2 size = {std::max(image.size.x / 2, 1u), std::max(image.size.y / 2, 1u)};
+			std::vector<std::byte> out(size_t(size.x) * size.y * 4);
+			auto stride = image.stride();
+			for(size_t y = 0; y < size.y; ++y)
+				for(size_t x = 0; x < size.x; ++x)
+					for(size_t c = 0; c < 4; ++c) {
+						uint32_t sum = 0;
+						for(size_t dy = 0; dy < 2; ++dy)
+							for(size_t dx = 0; dx < 2; ++dx) {
+								auto sx = std::min<size_t>(x * 2 + dx, image.size.x - 1), sy = std::min<size_t>(y * 2 + dy, image.size.y - 1);
+								sum += std::to_integer<uint8_t>(image.pixels[sy * stride + sx * 4 + c]);
+							}
+						out[(y * size.x + x) * 4 + c] = std::byte((sum + 2) / 4);
+					}
+			return out;
+		}
+
+		struct compression_cache {
+			std::mutex mutex;
+			std::unordered_map<uint64_t, std::shared_ptr<const compressed_image>> entries;
+			std::filesystem::path directory;
+
+			static compression_cache& get() {
+				static compression_cache cache;
+				return cache;
+			}
+
+			std::filesystem::path path(uint64_t hash) {
+				char name[32];
+				std::snprintf(name, sizeof(name), "%016llx.stylizer-bc", (unsigned long long)hash);
+				return directory / name;
+			}
+
+			std::shared_ptr<const compressed_image> load(uint64_t hash) {
+				if(directory.empty()) return nullptr;
+				std::ifstream file(path(hash), std::ios::binary);
+				if(!file) return nullptr;
+
+				auto out = std::make_shared<compressed_image>();
+				uint32_t header[4]; // format, width, height, mip count
+				if(!file.read((char*)header, sizeof(header))) return nullptr;
+				out->format = (block_format)header[0];
+				out->size = {header[1], header[2]};
+				out->mips.resize(header[3]);
+				for(auto& mip: out->mips) {
+					uint64_t size;
+					if(!file.read((char*)&size, sizeof(size))) return nullptr;
+					mip.resize(size);
+					if(!file.read((char*)mip.data(), size)) return nullptr;
+				}
+				return out;
+			}
+
+			void save(uint64_t hash, const compressed_image& image) {
+				if(directory.empty()) return;
+				std::filesystem::create_directories(directory);
+				std::ofstream file(path(hash), std::ios::binary);
+				uint32_t header[4] = {(uint32_t)image.format, image.size.x, image.size.y, (uint32_t)image.mips.size()};
+				file.write((const char*)header, sizeof(header));
+				for(auto& mip: image.mips) {
+					uint64_t size = mip.size();
+					file.write((const char*)&size, sizeof(size));
+					file.write((const char*)mip.data(), size);
+				}
+			}
+		};
+	}
+
+	void texture_compression::encode_block_rows(block_format format, const image_view& image, size_t first_block_row, size_t block_rows, std::byte* out) {
+		auto blocks = block_count(image.size);
+		auto bytes = block_bytes(format);
+		auto last = std::min<size_t>(first_block_row + block_rows, blocks.y);
+		for(size_t by = first_block_row; by < last; ++by)
+			for(size_t bx = 0; bx < blocks.x; ++bx)
+				encode_block(format, load_block(image, bx, by), out + (by * blocks.x + bx) * bytes);
+	}
+
+	std::vector<std::byte> texture_compression::compress(block_format format, const image_view& image, size_t block_rows_per_task /* = 8 */) {
+		std::vector<std::byte> out(compressed_size(format, image.size));
+		if(image.size.x == 0 || image.size.y == 0) return out;
+
+		auto rows = block_count(image.size).y;
+		block_rows_per_task = std::max<size_t>(block_rows_per_task, 1);
+		if(rows <= block_rows_per_task) {
+			encode_block_rows(format, image, 0, rows, out.data());
+			return out;
+		}
+
+		// The calling thread takes the first range instead of idling
+		std::vector<std::future<void>> tasks;
+		for(size_t first = block_rows_per_task; first < rows; first += block_rows_per_task)
+			tasks.emplace_back(thread_pool::enqueue([format, &image, first, block_rows_per_task, data = out.data()] {
+				encode_block_rows(format, image, first, block_rows_per_task, data);
+			}));
+		encode_block_rows(format, image, 0, block_rows_per_task, out.data());
+		for(auto& task: tasks) task.get();
+		return out;
+	}
+
+	std::shared_ptr<const compressed_image> texture_compression::compress_cached(block_format format, const image_view& image, bool generate_mips /* = true */) {
+		auto& cache = compression_cache::get();
+		auto hash = hash_value(format);
+		hash = hash_value(image.size.x, hash);
+		hash = hash_value(image.size.y, hash);
+		hash = hash_value(generate_mips, hash);
+		for(size_t y = 0; y < image.size.y; ++y)
+			hash = hash_bytes(image.pixels.subspan(y * image.stride(), size_t(image.size.x) * 4), hash);
+
+		{
+			std::scoped_lock lock(cache.mutex);
+			if(auto found = cache.entries.find(hash); found != cache.entries.end())
+				return found->second;
+			if(auto loaded = cache.load(hash))
+				return cache.entries[hash] = loaded;
+		}
+
+		auto out = std::make_shared<compressed_image>();
+		out->format = format;
+		out->size = image.size;
+		out->mips.emplace_back(compress(format, image));
+		if(generate_mips) {
+			auto level = image;
+			std::vector<std::byte> storage;
+			while(level.size.x > 1 || level.size.y > 1) {
+				storage = downsample(level);
+				level = {storage, {std::max(level.size.x / 2, 1u), std::max(level.size.y / 2, 1u)}};
+				out->mips.emplace_back(compress(format, level));
+			}
+		}
+
+		std::scoped_lock lock(cache.mutex);
+		cache.save(hash, *out);
+		return cache.entries[hash] = out;
+	}
+
+	void texture_compression::set_cache_directory(std::filesystem::path directory) {
+		auto& cache = compression_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		cache.directory = std::move(directory);
+	}
+
+	void texture_compression::clear_cache() {
+		auto& cache = compression_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		cache.entries.clear();
+	}
+
+	std::vector<std::byte> texture_compression::decompress(block_format format, std::span<const std::byte> blocks, uint2 size) {
+		std::vector<std::byte> out(size_t(size.x) * size.y * 4);
+		auto count = block_count(size);
+		auto bytes = block_bytes(format);
+		assert(blocks.size() >= compressed_size(format, size));
+
+		for(size_t by = 0; by < count.y; ++by)
+			for(size_t bx = 0; bx < count.x; ++bx) {
+				pixel_block block;
+				block.fill(255);
+				auto in = blocks.data() + (by * count.x + bx) * bytes;
+				switch(format) {
+					case block_format::BC1: decode_bc1(in, false, block.data()); break;
+					case block_format::BC3: decode_bc1(in + 8, true, block.data()); decode_bc4(in, 3, block.data()); break;
+					case block_format::BC5:
+						decode_bc4(in, 0, block.data()); decode_bc4(in + 8, 1, block.data());
+						for(size_t i = 0; i < 16; ++i) block[i * 4 + 2] = 0;
+						break;
+					case block_format::BC7: decode_bc7(in, block.data()); break;
+				}
+
+				for(size_t y = 0; y < 4 && by * 4 + y < size.y; ++y)
+					for(size_t x = 0; x < 4 && bx * 4 + x < size.x; ++x)
+						std::memcpy(out.data() + ((by * 4 + y) * size.x + bx * 4 + x) * 4, block.data() + (y * 4 + x) * 4, 4);
+			}
+		return out;
+	}
+
+	double texture_compression::psnr(block_format format, const image_view& original, std::span<const std::byte> decompressed) {
+		size_t channels = format == block_format::BC1 ? 3 : format == block_format::BC5 ? 2 : 4;
+		double squared_error = 0;
+		auto stride = original.stride();
+		for(size_t y = 0; y < original.size.y; ++y)
+			for(size_t x = 0; x < original.size.x; ++x)
+				for(size_t c = 0; c < channels; ++c) {
+					double d = std::to_integer<int>(original.pixels[y * stride + x * 4 + c]) - std::to_integer<int>(decompressed[(y * original.size.x + x) * 4 + c]);
+					squared_error += d * d;
+				}
+
+		double mse = squared_error / (double(original.size.x) * original.size.y * channels);
+		return mse == 0 ? std::numeric_limits<double>::infinity() : 10 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	texture_compression::benchmark_result texture_compression::benchmark(block_format format, const image_view& image, size_t iterations /* = 4 */) {
+		using clock = std::chrono::steady_clock;
+		iterations = std::max<size_t>(iterations, 1);
+
+		std::vector<std::byte> compressed;
+		auto start = clock::now();
+		for(size_t i = 0; i < iterations; ++i)
+			compressed = compress(format, image);
+		auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+		return {
+			.psnr = psnr(format, image, decompress(format, compressed, image.size)),
+			.megapixels_per_second = seconds > 0 ? double(image.size.x) * image.size.y * iterations / seconds / 1e6 : 0
+		};
+	}
+
+	void texture_compression::set_simd_enabled(bool enabled) { simd = enabled; }
+	bool texture_compression::simd_enabled() {
+#ifdef STYLIZER_COMPRESSION_SSE2
+		return simd;
+#else
+		return false;
+#endif
+	}
+
+	texture::format texture_compression::texture_format(block_format format, bool srgb) {
+		switch(format) {
+			case block_format::BC1: return srgb ? texture::format::BC1_RGBA_SRGB : texture::format::BC1_RGBA;
+			case block_format::BC3: return srgb ? texture::format::BC3_RGBA_SRGB : texture::format::BC3_RGBA;
+			case block_format::BC5: return texture::format::BC5_RG;
+			case block_format::BC7: return srgb ? texture::format::BC7_RGBA_SRGB : texture::format::BC7_RGBA;
+		}
+		return texture::format::BGRA8_SRGB;
+	}
+
+	tracked<texture> texture_compression::create_texture(context& ctx, const image_view& image, create_config config /* = {} */) {
+		if(!config.block_compression_supported || !block_aligned(image.size))
+			return create_uncompressed_texture(ctx, image, config);
+
+		auto compressed = compress_cached(config.format, image, config.generate_mips);
+		std::vector<std::span<const std::byte>> mips(compressed->mips.begin(), compressed->mips.end());
+		return create_texture(ctx, config.format, image.size, mips, config);
+	}
+
+	tracked<texture> texture_compression::create_texture(context& ctx, block_format format, uint2 size, std::span<const std::span<const std::byte>> mips, create_config config /* = {} */) {
+		using namespace api::operators;
+		assert(!mips.empty());
+
+		if(!config.block_compression_supported || !block_aligned(size)) {
+			auto pixels = decompress(format, mips[0], size);
+			return create_uncompressed_texture(ctx, {pixels, size}, config);
+		}
+
+		auto out = ctx.create_texture({
+			.label = config.label,
+			.format = texture_format(format, config.srgb),
+			.usage = api::usage::TextureBinding | api::usage::CopyDestination,
+			.size = api::convert(uint3(size, 1)),
+			.mip_levels = (uint32_t)mips.size()
+		});
+
+		// Small mips are still stored as whole blocks, copies have to cover the block rounded (physical) size
+		for(size_t level = 0; level < mips.size(); ++level) {
+			uint2 blocks = block_count({std::max(size.x >> level, 1u), std::max(size.y >> level, 1u)});
+			assert(mips[level].size() >= size_t(blocks.x) * blocks.y * block_bytes(format));
+			out.write(ctx, mips[level], blocks.x * block_bytes(format), api::convert(uint3(blocks.x * 4, blocks.y * 4, 1)), level);
+		}
+		out.configure_sampler(ctx);
+		return out;
+	}
+
+	tracked<texture> texture_compression::create_uncompressed_texture(context& ctx, const image_view& image, const create_config& config) {
+		using namespace api::operators;
+
+		// Swizzled into the BGRA layout the rest of core uses
+		std::vector<std::byte> bgra(size_t(image.size.x) * image.size.y * 4);
+		for(size_t y = 0; y < image.size.y; ++y)
+			for(size_t x = 0; x < image.size.x; ++x) {
+				auto in = image.pixels.data() + y * image.stride() + x * 4;
+				auto out = bgra.data() + (y * image.size.x + x) * 4;
+				out[0] = in[2]; out[1] = in[1]; out[2] = in[0]; out[3] = in[3];
+			}
+		auto out = ctx.create_texture({
+			.label = config.label,
+			.format = config.srgb ? texture::format::BGRA8_SRGB : texture::format::BGRA8,
+			.usage = api::usage::TextureBinding | api::usage::CopyDestination,
+			.size = api::convert(uint3(image.size, 1))
+		});
+		out.write(ctx, bgra, size_t(image.size.x) * 4, api::convert(uint3(image.size, 1)));
+		out.configure_sampler(ctx);
+		return out;
+	}
+
+} // namespace stylizer
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "core.hpp"
+
+namespace stylizer {
+
+//////////////////////////////////////////////////////////////////////
+// # Block Compression
+//////////////////////////////////////////////////////////////////////
+
+
+	enum class block_format {
+		BC1, // RGB (1 bit alpha unused), 8 bytes per block
+		BC3, // RGBA, 16 bytes per block
+		BC5, // RG (ex. normal maps), 16 bytes per block
+		BC7, // RGBA (mode 6 only), 16 bytes per block
+	};
+
+	// Tightly packed (or row_stride padded) 8 bits per channel RGBA pixels
+	struct image_view {
+		std::span<const std::byte> pixels;
+		uint2 size = {};
+		size_t row_stride = 0; // 0 means size.x * 4
+
+		size_t stride() const { return row_stride ? row_stride : size_t(size.x) * 4; }
+	};
+
+	struct compressed_image {
+		block_format format;
+		uint2 size = {};
+		std::vector<std::vector<std::byte>> mips; // Level 0 is full resolution
+
+		operator bool() const { return !mips.empty(); }
+	};
+
+	struct compressed_texture_create_config {
+		std::string_view label = "Stylizer Compressed Texture";
+		block_format format = block_format::BC7;
+		bool srgb = true;
+		bool generate_mips = true;
+		bool block_compression_supported = false; // Set when the device was created with BC texture support
+	};
+
+	struct texture_compression {
+		using create_config = compressed_texture_create_config;
+
+		struct benchmark_result {
+			double psnr = 0; // dB, over the channels the format stores
+			double megapixels_per_second = 0;
+		};
+
+		static constexpr size_t block_bytes(block_format format) { return format == block_format::BC1 ? 8 : 16; }
+		static uint2 block_count(uint2 size) { return {(size.x + 3) / 4, (size.y + 3) / 4}; }
+		// Block compressed textures must be a whole number of blocks, unaligned images are uploaded uncompressed instead
+		static bool block_aligned(uint2 size) { return size.x % 4 == 0 && size.y % 4 == 0; }
+		static size_t compressed_size(block_format format, uint2 size) {
+			auto blocks = block_count(size);
+			return size_t(blocks.x) * blocks.y * block_bytes(format);
+		}
+
+		// Encodes rows [first_block_row, first_block_row + block_rows) of blocks into out (which points at the first block of the image)
+		static void encode_block_rows(block_format format, const image_view& image, size_t first_block_row, size_t block_rows, std::byte* out);
+		// Splits the image into block row ranges which are encoded in parallel on the thread_pool
+		// NOTE: Blocks until every range is finished, don't call from a thread_pool task
+		static std::vector<std::byte> compress(block_format format, const image_view& image, size_t block_rows_per_task = 8);
+		// Compresses the image (and optionally a box filtered mip chain), results are cached by content hash
+		static std::shared_ptr<const compressed_image> compress_cached(block_format format, const image_view& image, bool generate_mips = true);
+
+		// Expands blocks back to RGBA pixels, used to measure quality
+		static std::vector<std::byte> decompress(block_format format, std::span<const std::byte> blocks, uint2 size);
+		static double psnr(block_format format, const image_view& original, std::span<const std::byte> decompressed);
+		static benchmark_result benchmark(block_format format, const image_view& image, size_t iterations = 4);
+		// The SSE2 kernels (when compiled in) can be switched off to run the scalar code, both produce identical blocks
+		static void set_simd_enabled(bool enabled);
+		static bool simd_enabled();
+
+		// Compressed results are kept in memory and, if a directory is set, on disk between runs
+		static void set_cache_directory(std::filesystem::path directory);
+		static void clear_cache();
+
+		static texture::format texture_format(block_format format, bool srgb);
+		static tracked<texture> create_texture(context& ctx, const image_view& image, create_config config = {});
+		// Uploads already compressed mips (ex. straight out of a mapped asset_bundle), config.format is ignored
+		static tracked<texture> create_texture(context& ctx, block_format format, uint2 size, std::span<const std::span<const std::byte>> mips, create_config config = {});
+
+	protected:
+		static tracked<texture> create_uncompressed_texture(context& ctx, const image_view& image, const create_config& config);
+	};
+
+} // namespace stylizer
@@ -3,6 +3,21 @@
 #include "core.hpp"
 
 #include <battery/embed.hpp>
+#include <fstream>
+#include <sstream>
+
+#ifdef STYLIZER_TRACK_ALLOCATIONS
+	#include <cstdlib>
+	#include <new>
+
+	void* operator new(std::size_t size) {
+		++stylizer::allocation_counter::total();
+		if(auto out = std::malloc(size ? size : 1)) return out;
+		throw std::bad_alloc();
+	}
+	void operator delete(void* ptr) noexcept { std::free(ptr); }
+	void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
 
 namespace stylizer {
 
@@ -17,4 +32,469 @@ namespace stylizer {
 		}();
 	}
 
+	std::vector<shader_processor::vertex_input> shader_processor::reflect_vertex_inputs(std::span<const uint32_t> spirv) {
+		enum : uint32_t {
+			OpName = 5, OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypePointer = 32,
+			OpVariable = 59, OpDecorate = 71, DecorationLocation = 30, StorageClassInput = 1,
+		};
+		constexpr size_t header_size = 5;
+		if(spirv.size() < header_size) return {};
+
+		std::unordered_map<uint32_t, size_t> locations, component_counts;
+		std::unordered_map<uint32_t, uint32_t> pointee_types;
+		std::unordered_map<uint32_t, std::string> names;
+		std::vector<std::pair<uint32_t, uint32_t>> input_variables; // (id, pointer type)
+		for(size_t i = header_size; i < spirv.size(); ) {
+			uint32_t word_count = spirv[i] >> 16, opcode = spirv[i] & 0xFFFF;
+			if(word_count == 0 || i + word_count > spirv.size()) break; // Malformed, report what we have
+			auto operands = spirv.subspan(i + 1, word_count - 1);
+
+			switch(opcode) {
+				case OpName: names[operands[0]] = reinterpret_cast<const char*>(operands.data() + 1); break;
+				case OpTypeInt: case OpTypeFloat: component_counts[operands[0]] = 1; break;
+				case OpTypeVector: component_counts[operands[0]] = operands[2]; break;
+				case OpTypePointer: pointee_types[operands[0]] = operands[2]; break;
+				case OpVariable:
+					if(operands[2] == StorageClassInput)
+						input_variables.emplace_back(operands[1], operands[0]);
+					break;
+				case OpDecorate:
+					if(operands[1] == DecorationLocation)
+						locations[operands[0]] = operands[2];
+					break;
+			}
+			i += word_count;
+		}
+
+		std::vector<vertex_input> out;
+		for(auto [id, pointer]: input_variables) {
+			auto location = locations.find(id);
+			if(location == locations.end()) continue; // Builtins like SV_VertexID aren't fed by vertex buffers
+
+			auto components = component_counts.find(pointee_types[pointer]);
+			out.push_back({
+				.location = location->second,
+				.components = components == component_counts.end() ? 0 : components->second,
+				.name = names.contains(id) ? names[id] : std::string{}
+			});
+		}
+		std::sort(out.begin(), out.end(), [](auto& a, auto& b) { return a.location < b.location; });
+		return out;
+	}
+
+	void shader_processor::validate_vertex_inputs(std::span<const uint32_t> spirv, std::span<const vertex_buffer_layout> layouts, std::string_view entry_point /* = "vertex" */) {
+		auto component_count = [](vertex_attribute_format format) -> size_t {
+			using fmt = vertex_attribute_format;
+			switch(format) {
+				case fmt::f32x1: return 1;
+				case fmt::f32x2: return 2;
+				case fmt::f32x3: return 3;
+				case fmt::f32x4: return 4;
+				default: return 0; // Unknown, accept anything
+			}
+		};
+
+		std::unordered_map<size_t, vertex_attribute_format> provided;
+		for(auto& layout: layouts)
+			for(auto& attribute: layout.attributes)
+				provided[attribute.shader_location] = attribute.format;
+
+		std::stringstream errors;
+		for(auto& input: reflect_vertex_inputs(spirv)) {
+			auto name = input.name.empty() ? std::string{"<unnamed>"} : input.name;
+			auto found = provided.find(input.location);
+			if(found == provided.end()) {
+				errors << "\n\tinput " << name << " (location " << input.location << ") is not provided by any vertex buffer";
+				continue;
+			}
+
+			auto components = component_count(found->second);
+			if(components && input.components && components != input.components)
+				errors << "\n\tinput " << name << " (location " << input.location << ") expects " << input.components
+					<< " components but the vertex buffer provides " << components;
+		}
+
+		if(auto message = errors.str(); !message.empty())
+			throw vertex_layout_mismatch("Vertex layout doesn't match entry point `" + std::string{entry_point} + "`:" + message);
+	}
+
+	void gpu_memory_tracker::print_report(std::ostream& out) {
+		std::scoped_lock lock(mutex);
+		out << "Stylizer GPU memory: " << bytes << " bytes live, " << peak_bytes << " bytes peak" << std::endl;
+		for(auto& [name, category]: categories) {
+			out << "\t" << name << ": " << category.bytes << " bytes in " << category.live_allocations << " allocations (peak "
+				<< category.peak_bytes << " bytes, " << category.total_allocations << " allocations total";
+			if(category.budget) out << ", budget " << *category.budget << " bytes";
+			out << ")" << std::endl;
+		}
+	}
+
+	bool gpu_memory_tracker::print_leak_report(std::ostream& out) {
+		std::scoped_lock lock(mutex);
+		if(allocations.empty()) return false;
+
+		// Sorted by id so the report lists leaks in creation order
+		std::vector<std::pair<allocation_id, const allocation*>> leaked;
+		leaked.reserve(allocations.size());
+		for(auto& [id, alloc]: allocations)
+			leaked.emplace_back(id, &alloc);
+		std::sort(leaked.begin(), leaked.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+		out << "Stylizer GPU memory leak: " << leaked.size() << " allocations (" << bytes << " bytes) still alive at context release" << std::endl;
+		for(auto& [id, alloc]: leaked)
+			out << "\t#" << id << " [" << alloc->category << "] \"" << alloc->label << "\" " << alloc->size.x << "x" << alloc->size.y << "x" << alloc->size.z
+				<< " (" << alloc->bytes << " bytes)" << std::endl;
+		return true;
+	}
+
+	void final_composite::statistics::print_report(std::ostream& out, uint2 reference_size /* = {3840, 2160} */, texture::format reference_format /* = BGRA8_SRGB */, size_t reference_fps /* = 60 */) const {
+		auto frames = direct_frames + blit_frames;
+		auto per_frame = blit_bytes(reference_size, reference_format);
+		out << "Stylizer final composite: " << direct_frames << " of " << frames << " frames rendered directly to the surface, "
+			<< bytes_saved << " bytes of blit traffic avoided" << std::endl;
+		out << "\tAt " << reference_size.x << "x" << reference_size.y << " each direct frame saves " << per_frame << " bytes ("
+			<< double(per_frame * reference_fps) / (1024 * 1024 * 1024) << " GiB/s at " << reference_fps << " fps)" << std::endl;
+	}
+
+	void readback_ring::statistics::print_report(std::ostream& out) const {
+		using milliseconds = std::chrono::duration<double, std::milli>;
+		out << "Stylizer readback: " << completed << " of " << requested << " frames read back (" << dropped << " dropped), "
+			<< frames_per_second() << " fps, " << bytes_per_second() / (1024 * 1024) << " MiB/s" << std::endl;
+		out << "\tLatency: " << milliseconds(average_latency()).count() << " ms average, " << milliseconds(max_latency).count() << " ms max" << std::endl;
+	}
+
+	bool command_recorder::save(const std::filesystem::path& path) {
+		std::ofstream file(path, std::ios::binary);
+		if(!file) return false;
+		file.write((const char*)stream.data(), stream.size());
+		return file.good();
+	}
+
+	void dynamic_resolution::create_upscale_pipeline(context& ctx, texture& target) {
+		if(upscale_pipeline) upscale_pipeline.release();
+		for(auto& shader: upscale_shaders)
+			if(shader.is_managed) shader->release();
+
+		auto [shaders, eps] = shader_processor::process_shaders(ctx, b::embed<"shaders/embeded/stylizer.upscale.slang">().str(), {
+			{api::shader::stage::Vertex, "vertex"},
+			{api::shader::stage::Fragment, "fragment"},
+		}, "stylizer_upscale");
+		upscale_shaders = std::move(shaders);
+
+		auto_release pass = target.begin_drawing(ctx, float4{0, 0, 0, 1}, true, false); // Not submitted (or recorded), only used to describe the attachments
+		upscale_pipeline = ctx.device.create_render_pipeline_from_compatible_render_pass(eps, pass, {}, "Stylizer Dynamic Resolution Upscale Pipeline");
+		upscale_format = target.get_format();
+	}
+
+	dynamic_resolution& dynamic_resolution::upscale(context& ctx, texture& target, geometry_buffer& gbuffer, uint2 source) {
+		if(!upscale_pipeline || upscale_format != target.get_format())
+			create_upscale_pipeline(ctx, target);
+
+		// Issued straight to the device, replay reproduces the whole upscale from its Upscale command
+		auto target_size = target.get_size();
+		std::array<float, 4> data = {float(source.x), float(source.y), float(target_size.x), float(target_size.y)};
+		uniforms.write(ctx.device, std::as_bytes(std::span{data}));
+		auto group = upscale_pipeline.create_bind_group(ctx, 0, std::array<api::bind_group::binding, 2>{
+			api::bind_group::texture_binding{.texture = &gbuffer.color, .sampled = false},
+			api::bind_group::buffer_binding{.buffer = &uniforms}
+		});
+
+		target.begin_drawing(ctx, float4{0, 0, 0, 1}, true, false)
+			.bind_render_pipeline(ctx.device, upscale_pipeline)
+			.bind_render_group(ctx.device, group)
+			.draw(ctx.device, 3)
+			.one_shot_submit(ctx.device);
+		group.release();
+		return *this;
+	}
+
+	dynamic_resolution& dynamic_resolution::present(context& ctx, STYLIZER_API_TYPE(surface)& surface, geometry_buffer& gbuffer) {
+		auto now = clock::now();
+		if(work_start != clock::time_point{}) {
+			last_frame_time = now - work_start;
+			// Work fitting inside the refresh interval leaves the rest to vsync, otherwise the time blocked in acquire/present was the GPU catching up
+			auto interval = now - present_start;
+			if(interval > std::chrono::duration<float>(config.target_frame_time * (1 + config.dead_band)))
+				last_frame_time = interval;
+		}
+		present_start = now;
+
+		target = ctx.get_surface_texture(surface);
+		auto size = gbuffer.color.get_size(), target_size = target.get_size();
+		auto source = render_size(gbuffer);
+		bool full_size = source.x == size.x && source.y == size.y;
+
+		if(ctx.recorder) {
+			auto& record = ctx.record(full_size ? command_recorder::opcode::Blit : command_recorder::opcode::Upscale)
+				.write(gbuffer.recording_id).write(ctx.recorder->surface_id(&surface))
+				.write<uint32_t>(target_size.x).write<uint32_t>(target_size.y).write((uint32_t)target.get_format());
+			if(!full_size) record.write<uint32_t>(source.x).write<uint32_t>(source.y);
+		}
+		if(full_size) target.blit_from(ctx, gbuffer.color);
+		else upscale(ctx, target, gbuffer, source);
+
+		if(ctx.recorder) ctx.record(command_recorder::opcode::Present).write(ctx.recorder->surface_id(&surface));
+		surface.present(ctx.device);
+		work_start = clock::now();
+		return *this;
+	}
+
+
+	std::vector<std::byte> pipeline_manifest::entry::serialize() const {
+		std::vector<std::byte> out;
+		auto write = [&out]<typename T>(const T& value) {
+			auto bytes = std::as_bytes(std::span{&value, 1});
+			out.insert(out.end(), bytes.begin(), bytes.end());
+		};
+		auto write_string = [&](std::string_view string) {
+			write((uint32_t)string.size());
+			auto bytes = std::as_bytes(std::span{string.data(), string.size()});
+			out.insert(out.end(), bytes.begin(), bytes.end());
+		};
+
+		write_string(module);
+		write_string(source);
+		write((uint32_t)entry_points.size());
+		for(auto& [stage, name]: entry_points) {
+			write((uint32_t)stage);
+			write_string(name);
+		}
+		write((uint32_t)color_formats.size());
+		for(auto format: color_formats)
+			write((uint32_t)format);
+		write((uint8_t)depth_format.has_value);
+		write((uint32_t)(depth_format ? *depth_format : texture::format{}));
+		write((uint64_t)config.size());
+		out.insert(out.end(), config.begin(), config.end());
+		return out;
+	}
+
+	bool pipeline_manifest::load(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if(!file) return false;
+		std::vector<std::byte> data(file.tellg());
+		file.seekg(0);
+		if(!file.read((char*)data.data(), data.size())) return false;
+		size_t offset = 0;
+		auto read = [&]<typename T>(T& out) {
+			if(offset + sizeof(T) > data.size()) throw std::out_of_range("Truncated pipeline manifest");
+			std::memcpy(&out, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+		};
+		auto read_string = [&](std::string& out) {
+			uint32_t size; read(size);
+			if(offset + size > data.size()) throw std::out_of_range("Truncated pipeline manifest");
+			out.assign((const char*)data.data() + offset, size);
+			offset += size;
+		};
+
+		try {
+			std::array<char, 8> file_magic; uint32_t file_version, count;
+			read(file_magic); read(file_version);
+			if(file_magic != magic || file_version != version) return false;
+
+			read(count);
+			for(uint32_t i = 0; i < count; ++i) {
+				entry e;
+				uint32_t u32; uint64_t u64; uint8_t u8;
+				read_string(e.module);
+				read_string(e.source);
+				read(u32); e.entry_points.resize(u32);
+				for(auto& [stage, name]: e.entry_points) {
+					read(u32); stage = (api::shader::stage)u32;
+					read_string(name);
+				}
+				read(u32); e.color_formats.resize(u32);
+				for(auto& format: e.color_formats) {
+					read(u32); format = (texture::format)u32;
+				}
+				read(u8); read(u32);
+				if(u8) e.depth_format = (texture::format)u32;
+				read(u64);
+				if(offset + u64 > data.size()) throw std::out_of_range("Truncated pipeline manifest");
+				e.config.assign(data.begin() + offset, data.begin() + offset + u64);
+				offset += u64;
+
+				auto hash = e.hash();
+				std::scoped_lock lock(mutex);
+				if(index.contains(hash)) continue;
+				index[hash] = entries.size();
+				entries.emplace_back(std::move(e));
+				++stats.loaded;
+			}
+		} catch(std::out_of_range&) { return false; }
+		return true;
+	}
+
+	bool pipeline_manifest::save(const std::filesystem::path& path) const {
+		std::ofstream file(path, std::ios::binary);
+		if(!file) return false;
+		uint32_t count = entries.size();
+		file.write(magic.data(), magic.size());
+		file.write((const char*)&version, sizeof(version));
+		file.write((const char*)&count, sizeof(count));
+		for(auto& e: entries) {
+			auto bytes = e.serialize();
+			file.write((const char*)bytes.data(), bytes.size());
+		}
+		return file.good();
+	}
+
+	void pipeline_manifest::prewarm() {
+		std::vector<std::pair<uint64_t, entry>> todo;
+		{
+			std::scoped_lock lock(mutex);
+			for(auto& [hash, i]: index)
+				if(!pending.contains(hash))
+					todo.emplace_back(hash, entries[i]);
+		}
+
+		for(auto& [hash, e]: todo) {
+			// Only compiles, nothing here may touch the device or a geometry buffer
+			auto build = [e = std::move(e)]() -> prewarmed {
+				auto start = clock::now();
+				shader_processor::entry_points eps;
+				for(auto& [stage, name]: e.entry_points) eps[stage] = name;
+				command_stream_reader reader{};
+				auto config = e.read_config(reader);
+				auto compiled = shader_processor::compile(e.source, eps, e.module, std::span<const shader_processor::vertex_buffer_layout>{config.vertex_buffers});
+				return {std::move(compiled), clock::now() - start};
+			};
+
+			auto future = thread_pool::enqueue(std::move(build));
+			std::scoped_lock lock(mutex);
+			pending[hash] = std::move(future);
+			++stats.prewarmed;
+		}
+	}
+
+	void pipeline_manifest::build_pipelines(context& ctx) {
+		using namespace api::operators;
+		std::vector<std::pair<uint64_t, std::future<prewarmed>>> todo;
+		{
+			std::scoped_lock lock(mutex);
+			for(auto& [hash, future]: pending) todo.emplace_back(hash, std::move(future));
+			pending.clear();
+		}
+
+		for(auto& [hash, future]: todo) {
+			entry e;
+			{
+				std::scoped_lock lock(mutex);
+				e = entries[index.at(hash)];
+			}
+			prewarmed warmed;
+			try { warmed = future.get(); }
+			catch(...) {
+				std::scoped_lock lock(mutex);
+				++stats.failed;
+				continue; // Compiling it on first use will report the error
+			}
+
+			// Pipelines only need compatible attachments, so single pixel stand-ins of the recorded formats will do
+			auto start = clock::now();
+			std::vector<tracked<texture>> attachments; attachments.reserve(e.color_formats.size() + 1);
+			auto stand_in = [&](texture::format format) -> texture& {
+				return attachments.emplace_back(ctx.create_texture({
+					.label = "Stylizer Pipeline Manifest Stand-in Texture",
+					.format = format,
+					.usage = api::usage::RenderAttachment,
+					.size = api::convert(uint3(1, 1, 1))
+				}, "pipeline_manifest", false));
+			};
+			std::vector<api::render_pass::color_attachment> color_attachments;
+			for(auto format: e.color_formats)
+				color_attachments.push_back({.texture = &stand_in(format)});
+			std::optional<api::render_pass::depth_stencil_attachment> depth_attachment;
+			if(e.depth_format) depth_attachment = api::render_pass::depth_stencil_attachment{.texture = &stand_in(*e.depth_format)};
+
+			command_stream_reader reader{};
+			auto config = e.read_config(reader);
+			auto [shaders, eps] = shader_processor::create_shaders(ctx, std::move(warmed.compiled));
+			built_pipeline out{std::move(shaders), {}, {}};
+			{
+				auto_release pass = ctx.device.create_render_pass(color_attachments, depth_attachment, true); // Never submitted, only describes the attachments
+				out.pipeline = ctx.device.create_render_pipeline_from_compatible_render_pass(eps, pass, config, "Stylizer Default Material Pipeline");
+			}
+			for(auto& attachment: attachments) attachment.release();
+			out.creation_time = warmed.compile_time + (clock::now() - start);
+
+			std::scoped_lock lock(mutex);
+			built[hash] = std::move(out);
+			++stats.built;
+		}
+	}
+
+	optional<pipeline_manifest::built_pipeline> pipeline_manifest::take_pipeline(uint64_t hash) {
+		std::scoped_lock lock(mutex);
+		auto found = built.find(hash);
+		if(found == built.end()) return {};
+		built_pipeline out = std::move(found->second);
+		built.erase(found);
+
+		++stats.ready;
+		stats.prewarm_time += out.creation_time;
+		stats.time_saved += out.creation_time;
+		return out;
+	}
+
+	optional<shader_processor::compiled_shaders> pipeline_manifest::take(uint64_t hash) {
+		using namespace std::chrono_literals;
+		std::future<prewarmed> future;
+		{
+			std::scoped_lock lock(mutex);
+			auto found = pending.find(hash);
+			if(found == pending.end()) {
+				++stats.misses;
+				return {};
+			}
+			future = std::move(found->second);
+			pending.erase(found);
+		}
+
+		auto start = clock::now();
+		bool waited = future.wait_for(0s) != std::future_status::ready;
+		try {
+			auto warmed = future.get();
+			auto wait_time = clock::now() - start;
+
+			std::scoped_lock lock(mutex);
+			++stats.hits;
+			if(waited) ++stats.waited;
+			stats.prewarm_time += warmed.compile_time;
+			stats.time_saved += std::max(warmed.compile_time - wait_time, clock::duration{});
+			return std::move(warmed.compiled);
+		} catch(...) {
+			std::scoped_lock lock(mutex);
+			++stats.failed;
+			++stats.misses;
+			return {}; // Compiling it on the spot will report the error
+		}
+	}
+
+	void pipeline_manifest::release() {
+		std::unordered_map<uint64_t, std::future<prewarmed>> remaining;
+		std::unordered_map<uint64_t, built_pipeline> unused;
+		{
+			std::scoped_lock lock(mutex);
+			std::swap(remaining, pending);
+			std::swap(unused, built);
+		}
+		for(auto& [hash, future]: remaining)
+			future.wait();
+		for(auto& [hash, unclaimed]: unused) {
+			if(unclaimed.pipeline) unclaimed.pipeline.release();
+			for(auto& shader: unclaimed.shaders)
+				if(shader.is_managed) shader->release();
+		}
+	}
+
+	void pipeline_manifest::statistics::print_report(std::ostream& out) const {
+		using milliseconds = std::chrono::duration<double, std::milli>;
+		out << "Stylizer pipeline manifest: " << loaded << " loaded, " << recorded << " new this run, " << prewarmed << " prewarmed, " << built << " built (" << failed << " failed)" << std::endl;
+		out << "\tFirst use: " << ready << " hitches avoided (pipeline already built), " << hits << " only had their shaders prewarmed ("
+			<< waited << " waited on a compile still in flight), " << misses << " created on the spot" << std::endl;
+		out << "\t" << milliseconds(time_saved).count() << " ms of shader compilation and pipeline creation moved off first use (" << milliseconds(prewarm_time).count() << " ms spent prewarming them)" << std::endl;
+	}
+
 }
\ No newline at end of file
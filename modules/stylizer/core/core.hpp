@@ -8,6 +8,25 @@
 #include "stylizer/api/api.hpp"
 #include "thirdparty/thread_pool.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <variant>
+
 namespace stylizer {
 
 //////////////////////////////////////////////////////////////////////
@@ -22,7 +41,11 @@ namespace stylizer {
 		static ZenSepiol::ThreadPool& get_thread_pool(optional<size_t> initial_pool_size = {})
 #ifdef IS_STYLIZER_CORE_CPP
 		{
-			static ZenSepiol::ThreadPool pool(initial_pool_size ? *initial_pool_size : std::thread::hardware_concurrency() - 1);
+			// Always at least one worker (hardware_concurrency may be 1, or 0 when unknown) so every task makes progress
+			static ZenSepiol::ThreadPool pool([&] {
+				auto hardware = std::thread::hardware_concurrency();
+				return std::max<size_t>(initial_pool_size ? *initial_pool_size : (hardware > 1 ? hardware - 1 : 1), 1);
+			}());
 			return pool;
 		}
 #else
@@ -34,6 +57,568 @@ namespace stylizer {
 		static auto enqueue(F&& function, optional<size_t> initial_pool_size = {}, Args&&... args) {
 			return get_thread_pool(initial_pool_size).AddTask(function, args...);
 		}
+
+		// Allocates the task and its shared state from the provided resource (usually a frame_arena) and
+		// submits it through the pool's intrusive queue, so nothing touches the heap
+		// NOTE: The task and its future must be finished with before the resource is reset, frame_arena::reset asserts this
+		template <typename F>
+		static auto enqueue(std::pmr::memory_resource* resource, F&& function, optional<size_t> initial_pool_size = {}) {
+			using R = std::invoke_result_t<std::decay_t<F>>;
+			struct task: public ZenSepiol::ThreadPool::IntrusiveTask {
+				std::pmr::memory_resource* resource;
+				std::decay_t<F> function;
+				std::promise<R> promise;
+			};
+
+			std::pmr::polymorphic_allocator<task> allocator(resource);
+			task* t = allocator.allocate(1);
+			new(t) task{{}, resource, std::forward<F>(function), std::promise<R>(std::allocator_arg, allocator)};
+			auto future = t->promise.get_future();
+
+			t->run = [](ZenSepiol::ThreadPool::IntrusiveTask* self) {
+				auto t = static_cast<task*>(self);
+				try {
+					if constexpr(std::is_void_v<R>) {
+						t->function();
+						t->promise.set_value();
+					} else t->promise.set_value(t->function());
+				} catch(...) { t->promise.set_exception(std::current_exception()); }
+
+				std::pmr::polymorphic_allocator<task> allocator(t->resource);
+				std::destroy_at(t);
+				allocator.deallocate(t, 1);
+			};
+			get_thread_pool(initial_pool_size).AddIntrusiveTask(t);
+			return future;
+		}
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Coroutines
+//////////////////////////////////////////////////////////////////////
+
+
+	template<typename T>
+	struct task_promise_result {
+		std::optional<T> value;
+		void return_value(T v) { value.emplace(std::move(v)); }
+		T take() { return std::move(*value); }
+	};
+	template<>
+	struct task_promise_result<void> {
+		void return_void() {}
+		void take() {}
+	};
+
+	// Lazily started coroutine, either co_await it from another task or start() it and poll done()
+	template<typename T = void>
+	struct task {
+		struct promise_type: public task_promise_result<T> {
+			std::coroutine_handle<> continuation = std::noop_coroutine();
+			std::exception_ptr exception = nullptr;
+			std::atomic<bool> completed = false;
+
+			task get_return_object() { return task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			auto final_suspend() noexcept {
+				struct awaitable {
+					bool await_ready() noexcept { return false; }
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+						auto continuation = handle.promise().continuation; // The promise may be destroyed once completed is set
+						handle.promise().completed.store(true, std::memory_order_release);
+						return continuation;
+					}
+					void await_resume() noexcept {}
+				};
+				return awaitable{};
+			}
+			void unhandled_exception() { exception = std::current_exception(); }
+		};
+
+		std::coroutine_handle<promise_type> handle = nullptr;
+
+		task() = default;
+		explicit task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+		task(const task&) = delete;
+		task(task&& o) : handle(std::exchange(o.handle, nullptr)), started(std::exchange(o.started, false)) {}
+		task& operator=(const task&) = delete;
+		task& operator=(task&& o) {
+			if(this == &o) return *this;
+			if(handle) {
+				assert(done() || !started); // Destroying a suspended task would drop whatever it is waiting on
+				handle.destroy();
+			}
+			handle = std::exchange(o.handle, nullptr);
+			started = std::exchange(o.started, false);
+			return *this;
+		}
+		~task() {
+			assert(!handle || done() || !started); // Destroying a suspended task would drop whatever it is waiting on
+			if(handle) handle.destroy();
+		}
+
+		operator bool() const { return handle; }
+
+		// Runs until the first suspension point, progress then happens in context::process_events or on the thread_pool
+		task& start() {
+			assert(handle && !started);
+			started = true;
+			handle.resume();
+			return *this;
+		}
+		bool done() const { return handle && handle.promise().completed.load(std::memory_order_acquire); }
+		// Rethrows anything the coroutine threw
+		T get() {
+			assert(done());
+			if(handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+			return handle.promise().take();
+		}
+
+		bool await_ready() const { return done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+			assert(!started);
+			started = true;
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+		T await_resume() { return get(); }
+
+	protected:
+		bool started = false;
+	};
+
+	template<typename T>
+	struct tracked;
+
+	// Resumes coroutines on the thread which pumps it (the render thread, from context::process_events) or on the thread_pool
+	struct coroutine_scheduler {
+		std::vector<tracked<STYLIZER_API_TYPE(buffer)>> fences; // Recycled by context::submitted_work_done
+
+		void schedule(std::coroutine_handle<> handle) {
+			std::scoped_lock lock(mutex);
+			ready.push_back(handle);
+		}
+		// Resumed by the first pump after ready returns true, ready is only ever called from pump
+		void schedule_when(std::function<bool()> ready, std::coroutine_handle<> handle) {
+			std::scoped_lock lock(mutex);
+			waiting.emplace_back(std::move(ready), handle);
+		}
+
+		auto on_render_thread() {
+			struct awaitable {
+				coroutine_scheduler& scheduler;
+				bool await_ready() const { return false; }
+				void await_suspend(std::coroutine_handle<> handle) { scheduler.schedule(handle); }
+				void await_resume() {}
+			};
+			return awaitable{*this};
+		}
+		static auto on_pool() {
+			struct awaitable {
+				bool await_ready() const { return false; }
+				void await_suspend(std::coroutine_handle<> handle) { thread_pool::enqueue([handle] { handle.resume(); }); }
+				void await_resume() {}
+			};
+			return awaitable{};
+		}
+		// Suspends until predicate returns true, resuming on the render thread
+		template<typename F>
+		auto until(F predicate) {
+			struct awaitable {
+				coroutine_scheduler& scheduler;
+				F predicate;
+				bool await_ready() { return predicate(); }
+				void await_suspend(std::coroutine_handle<> handle) { scheduler.schedule_when([this] { return predicate(); }, handle); }
+				void await_resume() {}
+			};
+			return awaitable{*this, std::move(predicate)};
+		}
+		// Suspends until the future resolves (ex. a buffer mapping, which only resolves inside context::process_events)
+		template<typename T>
+		auto wait(std::future<T> future) {
+			struct awaitable {
+				coroutine_scheduler& scheduler;
+				std::future<T> future;
+				bool is_ready() const {
+					using namespace std::chrono_literals;
+					return future.wait_for(0s) == std::future_status::ready;
+				}
+				bool await_ready() const { return is_ready(); }
+				void await_suspend(std::coroutine_handle<> handle) { scheduler.schedule_when([this] { return is_ready(); }, handle); }
+				T await_resume() { return future.get(); }
+			};
+			return awaitable{*this, std::move(future)};
+		}
+
+		// Resumes everything which became ready, returns how many coroutines were resumed
+		// NOTE: The scratch lists come from scratch (context passes its frame arena), the queues keep their capacity
+		size_t pump(std::pmr::memory_resource* scratch = std::pmr::new_delete_resource()) {
+			std::pmr::vector<std::coroutine_handle<>> resume(scratch);
+			std::pmr::vector<std::pair<std::function<bool()>, std::coroutine_handle<>>> still_waiting(scratch);
+			{
+				std::scoped_lock lock(mutex);
+				resume.assign(ready.begin(), ready.end());
+				still_waiting.assign(std::make_move_iterator(waiting.begin()), std::make_move_iterator(waiting.end()));
+				ready.clear();
+				waiting.clear();
+			}
+			std::erase_if(still_waiting, [&](auto& waiter) {
+				if(!waiter.first()) return false;
+				resume.push_back(waiter.second);
+				return true;
+			});
+			if(!still_waiting.empty()) {
+				std::scoped_lock lock(mutex);
+				waiting.insert(waiting.end(), std::make_move_iterator(still_waiting.begin()), std::make_move_iterator(still_waiting.end()));
+			}
+
+			// Resumed coroutines may schedule themselves again, those run in the next pump
+			for(auto handle: resume) handle.resume();
+			return resume.size();
+		}
+
+		size_t pending() {
+			std::scoped_lock lock(mutex);
+			return ready.size() + waiting.size();
+		}
+
+		void release();
+
+	protected:
+		std::mutex mutex;
+		std::vector<std::coroutine_handle<>> ready;
+		std::vector<std::pair<std::function<bool()>, std::coroutine_handle<>>> waiting;
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Hashing
+//////////////////////////////////////////////////////////////////////
+
+
+	// 64 bit FNV-1a, used to key caches by content
+	constexpr uint64_t hash_bytes(std::span<const std::byte> bytes, uint64_t seed = 0xcbf29ce484222325) {
+		for(auto byte: bytes) {
+			seed ^= static_cast<uint64_t>(byte);
+			seed *= 0x100000001b3;
+		}
+		return seed;
+	}
+	inline uint64_t hash_bytes(std::string_view string, uint64_t seed = 0xcbf29ce484222325) {
+		return hash_bytes(std::as_bytes(std::span{string.data(), string.size()}), seed);
+	}
+	template<typename T> requires(std::is_trivially_copyable_v<T>)
+	uint64_t hash_value(const T& value, uint64_t seed = 0xcbf29ce484222325) {
+		return hash_bytes(std::as_bytes(std::span{&value, 1}), seed);
+	}
+
+
+//////////////////////////////////////////////////////////////////////
+// # Frame Arena
+//////////////////////////////////////////////////////////////////////
+
+
+	// Bump allocator for data which only lives for a single frame, reset by context::next_frame
+	struct frame_arena {
+		// Counts live allocations so reset can tell when something (ex. a queued thread_pool task or an unread future) still uses the arena
+		struct counting_resource: public std::pmr::memory_resource {
+			std::pmr::memory_resource* upstream;
+			std::atomic<size_t> live = 0;
+
+			counting_resource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+		protected:
+			void* do_allocate(size_t bytes, size_t alignment) override {
+				auto out = upstream->allocate(bytes, alignment);
+				++live;
+				return out;
+			}
+			// NOTE: May run on any thread, the monotonic upstream ignores deallocations
+			void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+				--live;
+				upstream->deallocate(pointer, bytes, alignment);
+			}
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		};
+
+		std::unique_ptr<std::byte[]> buffer;
+		size_t capacity;
+		std::pmr::monotonic_buffer_resource resource;
+		counting_resource counted{&resource};
+
+		// Overflowing the capacity falls back to the heap (which allocation_counter will notice)
+		frame_arena(size_t capacity = 64 * 1024) : buffer(new std::byte[capacity]), capacity(capacity), resource(buffer.get(), capacity) {}
+
+		operator std::pmr::memory_resource*() { return &counted; }
+		template<typename T = std::byte>
+		std::pmr::polymorphic_allocator<T> allocator() { return &counted; }
+
+		size_t live_allocations() const { return counted.live.load(); }
+
+		// Memory which is still in use is kept (and the arena keeps growing) until a later reset finds it unused
+		void reset() {
+			assert(live_allocations() == 0); // Arena memory outlived its frame
+			if(live_allocations() == 0) resource.release();
+		}
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Allocation Tracking
+//////////////////////////////////////////////////////////////////////
+
+
+	// Counts global operator new calls when core is built with STYLIZER_TRACK_ALLOCATIONS
+	struct allocation_counter {
+#ifdef STYLIZER_TRACK_ALLOCATIONS
+		static constexpr bool enabled = true;
+#else
+		static constexpr bool enabled = false;
+#endif
+
+		static std::atomic<size_t>& total()
+#ifdef IS_STYLIZER_CORE_CPP
+		{
+			static std::atomic<size_t> count = 0;
+			return count;
+		}
+#else
+		;
+#endif
+
+		size_t start = total();
+
+		size_t allocations() const { return total() - start; }
+		void reset() { start = total(); }
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Field Reflection
+//////////////////////////////////////////////////////////////////////
+
+
+	namespace detail {
+		struct any_field {
+			template<typename T>
+			operator T() const; // Only used unevaluated
+		};
+		// Converts to what a single braced value can initialize without choosing between a class's copy and converting constructors
+		struct any_element {
+			template<typename T> requires(!std::is_class_v<T> || std::is_aggregate_v<T>)
+			operator T() const; // Only used unevaluated
+		};
+
+		template<typename T, size_t... I>
+		constexpr bool aggregate_constructible(std::index_sequence<I...>) { return requires { T{(void(I), any_field{})...}; }; }
+		// Braces stop brace elision, so this fails when a C array member made field_count count its elements instead
+		template<typename T, size_t... I>
+		constexpr bool field_wise_constructible(std::index_sequence<I...>) { return requires { T{{(void(I), any_element{})}...}; }; }
+
+		// Fields of a plain aggregate (no base classes), found by probing aggregate initialization
+		template<typename T, size_t N = 0>
+		constexpr size_t field_count() {
+			if constexpr(N < 12 && aggregate_constructible<T>(std::make_index_sequence<N + 1>{})) return field_count<T, N + 1>();
+			else return N;
+		}
+
+		// Calls f with every field of a plain aggregate, lets core serialize API structs without spelling out their layout
+		template<typename T, typename F>
+		void for_each_field(T& value, F&& f) {
+			constexpr size_t count = field_count<std::remove_cv_t<T>>();
+			static_assert(count < 12, "Too many fields to reflect");
+			static_assert(field_wise_constructible<std::remove_cv_t<T>>(std::make_index_sequence<count>{}), "Can't reflect C array members (or members which can't be initialized from a single braced value)");
+			if constexpr(count == 1) { auto& [a] = value; f(a); }
+			else if constexpr(count == 2) { auto& [a, b] = value; f(a); f(b); }
+			else if constexpr(count == 3) { auto& [a, b, c] = value; f(a); f(b); f(c); }
+			else if constexpr(count == 4) { auto& [a, b, c, d] = value; f(a); f(b); f(c); f(d); }
+			else if constexpr(count == 5) { auto& [a, b, c, d, e] = value; f(a); f(b); f(c); f(d); f(e); }
+			else if constexpr(count == 6) { auto& [a, b, c, d, e, g] = value; f(a); f(b); f(c); f(d); f(e); f(g); }
+			else if constexpr(count == 7) { auto& [a, b, c, d, e, g, h] = value; f(a); f(b); f(c); f(d); f(e); f(g); f(h); }
+			else if constexpr(count == 8) { auto& [a, b, c, d, e, g, h, i] = value; f(a); f(b); f(c); f(d); f(e); f(g); f(h); f(i); }
+			else if constexpr(count == 9) { auto& [a, b, c, d, e, g, h, i, j] = value; f(a); f(b); f(c); f(d); f(e); f(g); f(h); f(i); f(j); }
+			else if constexpr(count == 10) { auto& [a, b, c, d, e, g, h, i, j, k] = value; f(a); f(b); f(c); f(d); f(e); f(g); f(h); f(i); f(j); f(k); }
+			else if constexpr(count == 11) { auto& [a, b, c, d, e, g, h, i, j, k, l] = value; f(a); f(b); f(c); f(d); f(e); f(g); f(h); f(i); f(j); f(k); f(l); }
+		}
+
+		template<typename T>
+		struct is_optional : std::false_type {};
+		template<typename T>
+		struct is_optional<std::optional<T>> : std::true_type {};
+		template<typename T>
+		struct is_optional<stylizer::optional<T>> : std::true_type {};
+
+		template<typename T>
+		struct is_span : std::false_type {};
+		template<typename T, size_t N>
+		struct is_span<std::span<T, N>> : std::true_type {};
+
+		template<typename T>
+		constexpr bool unsupported_field = false; // Dependent false for static_assert
+	}
+
+
+//////////////////////////////////////////////////////////////////////
+// # Command Recording
+//////////////////////////////////////////////////////////////////////
+
+
+	// Compact binary log of everything issued through context, drawing_state and material,
+	// captured traces can be re-executed headlessly by the stylizer_replay tool
+	struct command_recorder {
+		enum class opcode : uint8_t {
+			CreateGeometryBuffer = 1, // id, width, height, color format, depth format
+			CreateMaterial, // id, gbuffer id, module, source, entry point count, (stage, name)..., pipeline config
+			BeginPass, // gbuffer id, target id (a surface or recorded texture), target width, height, format, clear color (4 floats), clear depth, one shot
+			BindMaterial, // material id
+			Draw, // vertex count, instance count, first vertex, first instance
+			EndPass,
+			OneShotSubmit,
+			Submit, // Every pass ended since the last submit
+			Blit, // gbuffer id, surface id, surface width, height, format
+			Present, // surface id
+			ProcessEvents,
+			EndFrame,
+			CreateBuffer, // id, create config
+			CreateTexture, // id, create config
+			WriteBuffer, // buffer id, offset, data
+			WriteTexture, // texture id, bytes per row, extent (3 uint32), mip, data
+			CreateBindGroup, // id, material id, group index, binding count, (kind, resource id, offset, size, sampled)...
+			BindGroup, // bind group id
+			BindVertexBuffer, // slot, buffer id, offset
+			BindIndexBuffer, // buffer id, offset
+			DrawIndexed, // index count, instance count, first index, base vertex, first instance
+			SetViewport, // x, y, width, height, min depth, max depth
+			BindUnrecordedPipeline, // A raw pipeline was bound, its draws can't be replayed
+			Upscale, // gbuffer id, surface id, surface width, height, format, source width, height
+		};
+
+		static constexpr std::array<char, 8> magic = {'S', 'T', 'Y', 'L', 'R', 'E', 'C', '\0'};
+		static constexpr uint32_t version = 2;
+
+		std::vector<std::byte> stream;
+		uint32_t next_id = 1;
+		std::unordered_map<const void*, uint32_t> surfaces;
+
+		command_recorder() {
+			stream.insert(stream.end(), (const std::byte*)magic.data(), (const std::byte*)magic.data() + magic.size());
+			write(version);
+		}
+
+		uint32_t new_id() { return next_id++; }
+		// Surfaces (and other render targets) aren't created through the recorder so they get an id the first time they are seen
+		uint32_t surface_id(const void* surface) {
+			auto [found, inserted] = surfaces.try_emplace(surface, 0);
+			if(inserted) found->second = new_id();
+			return found->second;
+		}
+
+		template<typename T> requires(std::is_trivially_copyable_v<T>)
+		command_recorder& write(const T& value) {
+			auto bytes = (const std::byte*)&value;
+			stream.insert(stream.end(), bytes, bytes + sizeof(T));
+			return *this;
+		}
+		command_recorder& write(std::string_view string) {
+			write<uint32_t>(string.size());
+			stream.insert(stream.end(), (const std::byte*)string.data(), (const std::byte*)string.data() + string.size());
+			return *this;
+		}
+		command_recorder& write(opcode op) { return write<uint8_t>(static_cast<uint8_t>(op)); }
+		command_recorder& write(std::span<const std::byte> data) {
+			write<uint64_t>(data.size());
+			stream.insert(stream.end(), data.begin(), data.end());
+			return *this;
+		}
+
+		// Walks API structs (ex. render_pipeline::config) field by field, mirrored by command_stream_reader::read_value
+		template<typename T>
+		command_recorder& write_value(const T& value) {
+			if constexpr(std::is_pointer_v<T>) {} // Pointers (and the handles behind them) mean nothing in another run
+			else if constexpr(std::is_arithmetic_v<T> || std::is_enum_v<T>) write(value);
+			else if constexpr(detail::is_optional<T>::value) {
+				write<uint8_t>(bool(value));
+				if(value) write_value(*value);
+			} else if constexpr(std::is_convertible_v<const T&, std::string_view>) write(std::string_view{value});
+			else if constexpr(std::ranges::sized_range<const T>) {
+				write<uint32_t>(std::ranges::size(value));
+				for(auto& element: value) write_value(element);
+			} else if constexpr(std::is_aggregate_v<T>) detail::for_each_field(value, [this](auto& field) { write_value(field); });
+			else static_assert(detail::unsupported_field<T>, "write_value only handles arithmetic, enum, optional, string, range and aggregate fields (ex. not hlslpp vectors)");
+			return *this;
+		}
+
+		bool save(const std::filesystem::path& path);
+	};
+
+	struct command_stream_reader {
+		std::span<const std::byte> stream;
+		size_t offset = 0;
+		std::vector<std::shared_ptr<void>> owned; // Storage behind spans filled in by read_value
+
+		static optional<command_stream_reader> open(std::span<const std::byte> stream) {
+			command_stream_reader out{stream, 0, {}};
+			if(stream.size() < command_recorder::magic.size() + sizeof(uint32_t)) return {};
+			if(!std::equal(command_recorder::magic.begin(), command_recorder::magic.end(), (const char*)stream.data())) return {};
+			out.offset = command_recorder::magic.size();
+			if(out.read<uint32_t>() != command_recorder::version) return {};
+			return out;
+		}
+
+		bool done() const { return offset >= stream.size(); }
+
+		template<typename T> requires(std::is_trivially_copyable_v<T>)
+		T read() {
+			T out;
+			if(offset + sizeof(T) > stream.size()) throw std::out_of_range("Truncated command stream");
+			std::memcpy(&out, stream.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return out;
+		}
+		std::string_view read_string() {
+			auto size = read<uint32_t>();
+			if(offset + size > stream.size()) throw std::out_of_range("Truncated command stream");
+			std::string_view out{(const char*)stream.data() + offset, size};
+			offset += size;
+			return out;
+		}
+		std::span<const std::byte> read_bytes() {
+			auto size = read<uint64_t>();
+			if(offset + size > stream.size()) throw std::out_of_range("Truncated command stream");
+			auto out = stream.subspan(offset, size);
+			offset += size;
+			return out;
+		}
+		command_recorder::opcode read_opcode() { return static_cast<command_recorder::opcode>(read<uint8_t>()); }
+
+		// Strings and spans read here point into the stream (or storage owned by the reader)
+		template<typename T>
+		void read_value(T& out) {
+			if constexpr(std::is_pointer_v<T>) out = nullptr;
+			else if constexpr(std::is_arithmetic_v<T> || std::is_enum_v<T>) out = read<T>();
+			else if constexpr(detail::is_optional<T>::value) {
+				if(read<uint8_t>()) {
+					std::remove_cvref_t<decltype(*out)> value{};
+					read_value(value);
+					out = std::move(value);
+				} else out = {};
+			} else if constexpr(std::is_same_v<T, std::string_view>) out = read_string();
+			else if constexpr(std::is_same_v<T, std::string>) out = std::string{read_string()};
+			else if constexpr(detail::is_span<T>::value) {
+				using element = std::remove_cv_t<typename T::element_type>;
+				auto storage = std::make_shared<std::vector<element>>(read<uint32_t>());
+				for(auto& e: *storage) read_value(e);
+				out = {storage->data(), storage->size()};
+				owned.emplace_back(std::move(storage));
+			} else if constexpr(std::ranges::sized_range<T>) {
+				auto count = read<uint32_t>();
+				if constexpr(requires { out.resize(count); }) out.resize(count);
+				else if(count != std::ranges::size(out)) throw std::runtime_error("Command stream doesn't match the recorded type");
+				for(auto& element: out) read_value(element);
+			} else if constexpr(std::is_aggregate_v<T>) detail::for_each_field(out, [this](auto& field) { read_value(field); });
+			else static_assert(detail::unsupported_field<T>, "read_value only handles arithmetic, enum, optional, string, range and aggregate fields (ex. not hlslpp vectors)");
+		}
 	};
 
 
@@ -44,12 +629,32 @@ namespace stylizer {
 
 	struct drawing_state: public STYLIZER_API_NAMESPACE::render_pass {
 		using super = STYLIZER_API_NAMESPACE::render_pass;
+		using super::bind_render_pipeline;
+		using super::bind_render_group;
+		using super::bind_vertex_buffer;
+		using super::bind_index_buffer;
+		using super::draw;
+		using super::draw_indexed;
+		using super::set_viewport;
+		using super::one_shot_submit;
 
 		struct context* context;
 		STYLIZER_NULLABLE(struct geometry_buffer*) gbuffer = nullptr;
 
+		// The overloads taking a context are captured by an active command_recorder
+		drawing_state& bind_material(struct context& ctx, struct material& material);
+		// NOTE: Raw pipelines can't be recreated by stylizer_replay, prefer bind_material
+		drawing_state& bind_render_pipeline(struct context& ctx, STYLIZER_API_TYPE(render_pipeline)& pipeline);
+		drawing_state& bind_group(struct context& ctx, struct material_bind_group& group);
+		drawing_state& bind_vertex_buffer(struct context& ctx, size_t slot, tracked<STYLIZER_API_TYPE(buffer)>& buffer, size_t offset = 0);
+		drawing_state& bind_index_buffer(struct context& ctx, tracked<STYLIZER_API_TYPE(buffer)>& buffer, size_t offset = 0);
+		drawing_state& draw(struct context& ctx, size_t vertex_count, size_t instance_count = 1, size_t first_vertex = 0, size_t first_instance = 0);
+		drawing_state& draw_indexed(struct context& ctx, size_t index_count, size_t instance_count = 1, size_t first_index = 0, size_t base_vertex = 0, size_t first_instance = 0);
+		drawing_state& set_viewport(struct context& ctx, uint2 origin, uint2 size, float min_depth = 0, float max_depth = 1);
+
 		STYLIZER_API_TYPE(command_buffer) end();
 		void one_shot_submit();
+		void one_shot_submit(struct context& ctx) { assert(&ctx == context); one_shot_submit(); }
 	};
 
 
@@ -61,12 +666,200 @@ namespace stylizer {
 	struct texture: public STYLIZER_API_NAMESPACE::texture {
 		using super = STYLIZER_API_NAMESPACE::texture;
 
-		drawing_state begin_drawing(context& ctx, float4 clear_color, bool one_shot = true);
-		drawing_state begin_drawing(context& ctx, optional<float3> clear_color = {}, bool one_shot = true) {
-			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, one_shot);
+		// Recorded passes are replayed into an offscreen stand-in with the same size and format
+		drawing_state begin_drawing(context& ctx, float4 clear_color, bool one_shot = true, bool record = true);
+		drawing_state begin_drawing(context& ctx, optional<float3> clear_color = {}, bool one_shot = true, bool record = true) {
+			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, one_shot, record);
+		}
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # GPU Memory Tracking
+//////////////////////////////////////////////////////////////////////
+
+
+	struct gpu_memory_tracker {
+		using allocation_id = size_t;
+
+		struct allocation {
+			std::string label;
+			std::string category;
+			optional<texture::format> format = {}; // Buffers have no format
+			uint3 size = {};
+			size_t bytes = 0;
+		};
+
+		struct category_usage {
+			size_t bytes = 0, peak_bytes = 0;
+			size_t live_allocations = 0, total_allocations = 0;
+			optional<size_t> budget = {};
+		};
+
+		// Stored next to the resource it describes, untracks the allocation when released
+		struct handle {
+			gpu_memory_tracker* tracker = nullptr;
+			allocation_id id = 0;
+
+			operator bool() const { return tracker && id; }
+			void release() { if(*this) std::exchange(tracker, nullptr)->untrack(id); }
+		};
+
+		event<gpu_memory_tracker&, std::string_view, const category_usage&> budget_exceeded;
+
+		std::unordered_map<allocation_id, allocation> allocations;
+		std::unordered_map<std::string, category_usage> categories;
+		size_t bytes = 0, peak_bytes = 0;
+
+		// Smallest addressable unit of a format, block compressed formats store 4x4 texels per block
+		struct texel_block {
+			size_t bytes = 4;
+			uint32_t width = 1, height = 1;
+
+			bool compressed() const { return width > 1 || height > 1; }
+		};
+		static texel_block block_of(texture::format format) {
+			switch(format) {
+				case texture::format::BC1_RGBA: case texture::format::BC1_RGBA_SRGB: return {8, 4, 4};
+				case texture::format::BC3_RGBA: case texture::format::BC3_RGBA_SRGB: return {16, 4, 4};
+				case texture::format::BC5_RG: return {16, 4, 4};
+				case texture::format::BC7_RGBA: case texture::format::BC7_RGBA_SRGB: return {16, 4, 4};
+				case texture::format::BGRA8: case texture::format::BGRA8_SRGB: return {4};
+				case texture::format::Depth24: return {4}; // Stored padded to 32 bits
+				default: return {4}; // NOTE: Formats core never creates are estimated as 32 bit
+			}
+		}
+		static size_t bytes_per_texel(texture::format format) {
+			assert(!block_of(format).compressed()); // Use row_bytes for block compressed formats
+			return block_of(format).bytes;
+		}
+		// Bytes in a row of texels (a row of blocks for compressed formats)
+		static size_t row_bytes(size_t width, texture::format format) {
+			auto block = block_of(format);
+			return (width + block.width - 1) / block.width * block.bytes;
+		}
+		// Rows of texels (or blocks) in an image
+		static size_t row_count(size_t height, texture::format format) {
+			auto block = block_of(format);
+			return (std::max<size_t>(height, 1) + block.height - 1) / block.height;
+		}
+		static size_t image_bytes(uint2 size, texture::format format) {
+			return row_bytes(size.x, format) * row_count(size.y, format);
+		}
+		// Every mip level, array layers (or depth slices) aren't mipped
+		static size_t estimate_bytes(const texture::create_config& config) {
+			size_t out = 0;
+			for(uint32_t level = 0; level < std::max<uint32_t>(config.mip_levels, 1); ++level) {
+				uint2 size = {std::max<uint32_t>(config.size.x >> level, 1), std::max<uint32_t>(config.size.y >> level, 1)};
+				out += image_bytes(size, config.format);
+			}
+			return out * std::max<size_t>(config.size.z, 1);
+		}
+
+		handle track(allocation alloc) {
+			std::vector<std::pair<std::string, category_usage>> exceeded;
+			allocation_id id;
+			{
+				std::scoped_lock lock(mutex);
+				id = next_id++;
+				auto& category = categories[alloc.category];
+				category.bytes += alloc.bytes;
+				category.peak_bytes = std::max(category.peak_bytes, category.bytes);
+				++category.live_allocations;
+				++category.total_allocations;
+				bytes += alloc.bytes;
+				peak_bytes = std::max(peak_bytes, bytes);
+				if(category.budget && category.bytes > *category.budget)
+					exceeded.emplace_back(alloc.category, category);
+				allocations.emplace(id, std::move(alloc));
+			}
+			// Callbacks run unlocked so they are free to release or track resources themselves
+			for(auto& [name, usage]: exceeded)
+				budget_exceeded(*this, name, usage);
+			return {this, id};
+		}
+		handle track(const texture::create_config& config, std::string_view category = "uncategorized") {
+			return track({
+				.label = std::string{config.label},
+				.category = std::string{category},
+				.format = config.format,
+				.size = api::convert(config.size),
+				.bytes = estimate_bytes(config)
+			});
+		}
+		handle track_buffer(std::string_view label, size_t bytes, std::string_view category = "uncategorized") {
+			return track({
+				.label = std::string{label},
+				.category = std::string{category},
+				.size = uint3(bytes, 1, 1),
+				.bytes = bytes
+			});
+		}
+		handle track(const STYLIZER_API_TYPE(buffer)::create_config& config, std::string_view category = "uncategorized") {
+			return track_buffer(config.label, config.size, category);
+		}
+
+		void untrack(allocation_id id) {
+			std::scoped_lock lock(mutex);
+			auto found = allocations.find(id);
+			if(found == allocations.end()) return;
+
+			auto& category = categories[found->second.category];
+			category.bytes -= found->second.bytes;
+			--category.live_allocations;
+			bytes -= found->second.bytes;
+			allocations.erase(found);
+		}
+
+		gpu_memory_tracker& set_budget(std::string_view category, optional<size_t> budget) {
+			std::scoped_lock lock(mutex);
+			categories[std::string{category}].budget = budget;
+			return *this;
+		}
+
+		category_usage usage(std::string_view category) {
+			std::scoped_lock lock(mutex);
+			auto found = categories.find(std::string{category});
+			return found == categories.end() ? category_usage{} : found->second;
+		}
+
+		void print_report(std::ostream& out);
+		// Returns true if any allocations were still alive
+		bool print_leak_report(std::ostream& out);
+
+	protected:
+		allocation_id next_id = 1;
+		std::mutex mutex;
+	};
+
+	// A resource created through context::create_texture or context::create_buffer, releasing it also untracks it
+	template<typename T>
+	struct tracked: public T {
+		gpu_memory_tracker::handle memory;
+		uint32_t recording_id = 0; // Set when created while a command_recorder was active
+
+		// Overloads the API's writes so an active command_recorder captures them
+		using T::write;
+		tracked& write(struct context& ctx, std::span<const std::byte> data, size_t offset = 0) requires(std::is_same_v<T, STYLIZER_API_TYPE(buffer)>);
+		tracked& write(struct context& ctx, std::span<const std::byte> data, size_t bytes_per_row, api::vec3u extent, size_t mip = 0) requires(std::is_same_v<T, texture>);
+
+		// Recorded passes target the texture by its recording_id (when it has one), so a trace which renders to it and then samples it replays correctly
+		drawing_state begin_drawing(struct context& ctx, float4 clear_color, bool one_shot = true, bool record = true) requires(std::is_same_v<T, texture>);
+		drawing_state begin_drawing(struct context& ctx, optional<float3> clear_color = {}, bool one_shot = true, bool record = true) requires(std::is_same_v<T, texture>) {
+			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, one_shot, record);
+		}
+
+		void release() {
+			T::release();
+			memory.release();
 		}
 	};
 
+	inline void coroutine_scheduler::release() {
+		for(auto& fence: fences) fence.release();
+		fences.clear();
+	}
+
 
 //////////////////////////////////////////////////////////////////////
 // # Context
@@ -76,6 +869,11 @@ namespace stylizer {
 	struct context {
 		STYLIZER_API_TYPE(device) device;
 		STYLIZER_API_TYPE(surface) surface;
+		std::shared_ptr<gpu_memory_tracker> memory = std::make_shared<gpu_memory_tracker>(); // Shared so handles stay valid when the context is moved
+		std::shared_ptr<command_recorder> recorder = nullptr; // Set to capture a trace
+		std::shared_ptr<frame_arena> arena = std::make_shared<frame_arena>();
+		std::shared_ptr<coroutine_scheduler> scheduler = std::make_shared<coroutine_scheduler>();
+		std::shared_ptr<struct pipeline_manifest> pipelines = nullptr; // Set to record material pipelines so a later run can prewarm them
 		operator bool() { return device || surface; }
 		operator stylizer::api::device&() { return device; } // Automatically convert to an API device!
 
@@ -89,36 +887,145 @@ namespace stylizer {
 		}
 #endif
 
-		void process_events() { device.process_events(); }
-		void present() { surface.present(device); }
+		void process_events() {
+			if(recorder) record(command_recorder::opcode::ProcessEvents);
+			device.process_events();
+			if(scheduler) scheduler->pump(arena ? (std::pmr::memory_resource*)*arena : std::pmr::new_delete_resource());
+		}
+		// Completes once everything submitted so far has finished executing on the GPU
+		// NOTE: The context must not move while the task is pending
+		task<> submitted_work_done();
+		// Marks the frame boundary, everything allocated from the frame arena is released
+		void next_frame() {
+			if(recorder) record(command_recorder::opcode::EndFrame);
+			if(arena) arena->reset();
+		}
+		void present() {
+			if(recorder) record(command_recorder::opcode::Present).write(recorder->surface_id(&surface));
+			surface.present(device);
+		}
+
+		command_recorder& record(command_recorder::opcode op) {
+			assert(recorder);
+			return recorder->write(op);
+		}
+		// The target is identified by its recording id when it has one (a recorded texture), otherwise by address (ex. a surface)
+		void record_begin_pass(uint32_t gbuffer_id, STYLIZER_NULLABLE(const void*) target, STYLIZER_NULLABLE(STYLIZER_API_NAMESPACE::texture*) target_texture, float4 clear_color, float clear_depth, bool one_shot, uint32_t target_id = 0) {
+			auto size = target_texture ? target_texture->get_size() : api::vec3u{};
+			if(!target_id && target) target_id = recorder->surface_id(target);
+			record(command_recorder::opcode::BeginPass).write(gbuffer_id).write(target_id)
+				.write<uint32_t>(size.x).write<uint32_t>(size.y).write<uint32_t>(target_texture ? (uint32_t)target_texture->get_format() : 0)
+				.write<float>(clear_color.x).write<float>(clear_color.y).write<float>(clear_color.z).write<float>(clear_color.w)
+				.write(clear_depth).write<uint8_t>(one_shot);
+		}
+
+		// Creates the resource and records it with the memory tracker under category,
+		// record = false leaves it out of an active trace (ex. when a higher level command recreates it)
+		tracked<texture> create_texture(const texture::create_config& config, std::string_view category = "texture", bool record = true) {
+			tracked<texture> out;
+			auto tmp = device.create_texture(config);
+			(texture&)out = std::move((texture&)tmp);
+			if(memory) out.memory = memory->track(config, category);
+			if(record && recorder) {
+				out.recording_id = recorder->new_id();
+				this->record(command_recorder::opcode::CreateTexture).write(out.recording_id).write_value(config);
+			}
+			return out;
+		}
+		tracked<STYLIZER_API_TYPE(buffer)> create_buffer(const STYLIZER_API_TYPE(buffer)::create_config& config, std::string_view category = "buffer", bool record = true) {
+			tracked<STYLIZER_API_TYPE(buffer)> out;
+			(STYLIZER_API_TYPE(buffer)&)out = device.create_buffer(config);
+			if(memory) out.memory = memory->track(config, category);
+			if(record && recorder) {
+				out.recording_id = recorder->new_id();
+				this->record(command_recorder::opcode::CreateBuffer).write(out.recording_id).write_value(config);
+			}
+			return out;
+		}
 
-		texture get_surface_texture() {
+		texture get_surface_texture(STYLIZER_API_TYPE(surface)& surface) {
 			auto tmp = surface.next_texture(device);
 			return std::move((texture&)tmp);
 		}
+		texture get_surface_texture() { return get_surface_texture(surface); }
 		drawing_state begin_drawing_to_surface(float4 clear_color, bool one_shot = true) {
-			return get_surface_texture().begin_drawing(*this, clear_color, one_shot);
+			auto texture = get_surface_texture();
+			if(recorder) record_begin_pass(0, &surface, &texture, clear_color, 1, one_shot);
+			return texture.begin_drawing(*this, clear_color, one_shot, false);
 		}
 		drawing_state begin_drawing_to_surface(optional<float3> clear_color = {}, bool one_shot = true) {
 			return begin_drawing_to_surface(clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, one_shot);
 		}
 
-		void release(bool static_sub_objects = false) {
-			device.release(static_sub_objects);
-			surface.release();
-		}
+		void release(bool static_sub_objects = false);
 	};
 
 	inline STYLIZER_API_TYPE(command_buffer) drawing_state::end() {
 		assert(context);
+		if(context->recorder) context->record(command_recorder::opcode::EndPass);
 		return super::end(context->device);
 	}
 	inline void drawing_state::one_shot_submit() {
 		assert(context);
+		if(context->recorder) context->record(command_recorder::opcode::OneShotSubmit);
 		super::one_shot_submit(context->device);
 	}
+	inline drawing_state& drawing_state::draw(struct context& ctx, size_t vertex_count, size_t instance_count /* = 1 */, size_t first_vertex /* = 0 */, size_t first_instance /* = 0 */) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::Draw)
+			.write<uint32_t>(vertex_count).write<uint32_t>(instance_count).write<uint32_t>(first_vertex).write<uint32_t>(first_instance);
+		super::draw(ctx.device, vertex_count, instance_count, first_vertex, first_instance);
+		return *this;
+	}
+	inline drawing_state& drawing_state::draw_indexed(struct context& ctx, size_t index_count, size_t instance_count /* = 1 */, size_t first_index /* = 0 */, size_t base_vertex /* = 0 */, size_t first_instance /* = 0 */) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::DrawIndexed).write<uint32_t>(index_count).write<uint32_t>(instance_count)
+			.write<uint32_t>(first_index).write<uint32_t>(base_vertex).write<uint32_t>(first_instance);
+		super::draw_indexed(ctx.device, index_count, instance_count, first_index, base_vertex, first_instance);
+		return *this;
+	}
+	inline drawing_state& drawing_state::bind_render_pipeline(struct context& ctx, STYLIZER_API_TYPE(render_pipeline)& pipeline) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::BindUnrecordedPipeline);
+		super::bind_render_pipeline(ctx.device, pipeline);
+		return *this;
+	}
+	inline drawing_state& drawing_state::bind_vertex_buffer(struct context& ctx, size_t slot, tracked<STYLIZER_API_TYPE(buffer)>& buffer, size_t offset /* = 0 */) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::BindVertexBuffer).write<uint32_t>(slot).write(buffer.recording_id).write<uint64_t>(offset);
+		super::bind_vertex_buffer(ctx.device, slot, buffer, offset);
+		return *this;
+	}
+	inline drawing_state& drawing_state::bind_index_buffer(struct context& ctx, tracked<STYLIZER_API_TYPE(buffer)>& buffer, size_t offset /* = 0 */) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::BindIndexBuffer).write(buffer.recording_id).write<uint64_t>(offset);
+		super::bind_index_buffer(ctx.device, buffer, offset);
+		return *this;
+	}
+	inline drawing_state& drawing_state::set_viewport(struct context& ctx, uint2 origin, uint2 size, float min_depth /* = 0 */, float max_depth /* = 1 */) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::SetViewport).write<uint32_t>(origin.x).write<uint32_t>(origin.y)
+			.write<uint32_t>(size.x).write<uint32_t>(size.y).write(min_depth).write(max_depth);
+		super::set_viewport(ctx.device, api::convert(origin), api::convert(size), min_depth, max_depth);
+		return *this;
+	}
+
+	template<typename T>
+	tracked<T>& tracked<T>::write(struct context& ctx, std::span<const std::byte> data, size_t offset /* = 0 */) requires(std::is_same_v<T, STYLIZER_API_TYPE(buffer)>) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::WriteBuffer).write(recording_id).write<uint64_t>(offset).write(data);
+		T::write(ctx.device, data, offset);
+		return *this;
+	}
+	template<typename T>
+	tracked<T>& tracked<T>::write(struct context& ctx, std::span<const std::byte> data, size_t bytes_per_row, api::vec3u extent, size_t mip /* = 0 */) requires(std::is_same_v<T, texture>) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::WriteTexture).write(recording_id).write<uint64_t>(bytes_per_row)
+			.write<uint32_t>(extent.x).write<uint32_t>(extent.y).write<uint32_t>(extent.z).write<uint32_t>(mip).write(data);
+		T::write(ctx.device, data, bytes_per_row, extent, mip);
+		return *this;
+	}
+
+	template<typename T>
+	drawing_state tracked<T>::begin_drawing(struct context& ctx, float4 clear_color, bool one_shot /* = true */, bool record /* = true */) requires(std::is_same_v<T, texture>) {
+		if(record && ctx.recorder) ctx.record_begin_pass(0, this, this, clear_color, 1, one_shot, recording_id);
+		return T::begin_drawing(ctx, clear_color, one_shot, false);
+	}
 
-	inline drawing_state texture::begin_drawing(context& ctx, float4 clear_color, bool one_shot /* = true */) {
+	inline drawing_state texture::begin_drawing(context& ctx, float4 clear_color, bool one_shot /* = true */, bool record /* = true */) {
+		if(record && ctx.recorder) ctx.record_begin_pass(0, this, this, clear_color, 1, one_shot);
 		auto pass = ctx.device.create_render_pass(std::array<api::render_pass::color_attachment, 1>{api::render_pass::color_attachment{
 			.texture = this, .clear_value = api::convert(clear_color)
 		}}, {}, one_shot);
@@ -143,7 +1050,8 @@ namespace stylizer {
 		using create_config = geometry_buffer_create_config;
 
 		create_config config;
-		STYLIZER_API_TYPE(texture) color, depth;
+		tracked<texture> color, depth;
+		uint32_t recording_id = 0;
 		operator bool() { return color || depth; }
 
 		static geometry_buffer create_default(context& ctx, uint2 size, create_config config = {}) {
@@ -151,19 +1059,26 @@ namespace stylizer {
 
 			geometry_buffer out;
 			out.config = config;
-			out.color = ctx.device.create_texture({
+			// CreateGeometryBuffer recreates both textures, so they aren't recorded on their own
+			out.color = ctx.create_texture({
 				.label = "Stylizer Gbuffer Color Texture",
 				.format = config.color_format,
-				.usage = api::usage::RenderAttachment | api::usage::TextureBinding,
+				.usage = api::usage::RenderAttachment | api::usage::TextureBinding | api::usage::CopySource,
 				.size = api::convert(uint3(size, 1))
-			});
+			}, "geometry_buffer", false);
 			out.color.configure_sampler(ctx);
-			out.depth = ctx.device.create_texture({
+			out.depth = ctx.create_texture({
 				.label = "Stylizer Gbuffer Depth Texture",
 				.format = config.depth_format,
 				.usage = api::usage::RenderAttachment | api::usage::TextureBinding,
 				.size = api::convert(uint3(size, 1))
-			});
+			}, "geometry_buffer", false);
+
+			if(ctx.recorder) {
+				out.recording_id = ctx.recorder->new_id();
+				ctx.record(command_recorder::opcode::CreateGeometryBuffer).write(out.recording_id).write<uint32_t>(size.x).write<uint32_t>(size.y)
+					.write((uint32_t)config.color_format).write((uint32_t)config.depth_format);
+			}
 			return out;
 		}
 
@@ -184,7 +1099,18 @@ namespace stylizer {
 		}
 
 		drawing_state begin_drawing(context& ctx, float4 clear_color, optional<float> clear_depth = {}, bool one_shot = true) {
+			if(ctx.recorder) ctx.record_begin_pass(recording_id, nullptr, nullptr, clear_color, clear_depth ? *clear_depth : 1, one_shot);
+			return begin_drawing_into(ctx, nullptr, clear_color, clear_depth, one_shot);
+		}
+		drawing_state begin_drawing(context& ctx, optional<float3> clear_color = {}, optional<float> clear_depth = {}, bool one_shot = true) {
+			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, clear_depth, one_shot);
+		}
+
+		// Draws with this gbuffer's depth but replaces the first color attachment (usually with the surface texture)
+		// NOTE: The target must have the same format and size as the color texture it replaces
+		drawing_state begin_drawing_into(context& ctx, STYLIZER_NULLABLE(STYLIZER_API_NAMESPACE::texture*) color_target, float4 clear_color, optional<float> clear_depth = {}, bool one_shot = true) {
 			auto color_attachments = this->color_attachments();
+			if(color_target) color_attachments[0].texture = color_target;
 			color_attachments[0].clear_value = api::convert(clear_color);
 			auto depth_attachment = this->depth_attachment();
 			depth_attachment->depth_clear_value = clear_depth ? *clear_depth : 1;
@@ -195,9 +1121,6 @@ namespace stylizer {
 			out.gbuffer = this;
 			return out;
 		}
-		drawing_state begin_drawing(context& ctx, optional<float3> clear_color = {}, optional<float> clear_depth = {}, bool one_shot = true) {
-			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, clear_depth, one_shot);
-		}
 
 		void release() {
 			color.release();
@@ -208,46 +1131,657 @@ namespace stylizer {
 
 
 //////////////////////////////////////////////////////////////////////
-// # Material
+// # Final Composite
 //////////////////////////////////////////////////////////////////////
 
 
-	struct shader_processor {
-		using entry_points = std::unordered_map<api::shader::stage, std::string_view>;
+	// Renders the last pass of a frame straight into the surface texture, only falling back to
+	// a full-screen blit from the geometry buffer when the surface's format or size differ.
+	// NOTE: On direct frames the gbuffer's color texture is not written, set capture while something reads it
+	struct final_composite {
+		struct statistics {
+			size_t direct_frames = 0, blit_frames = 0;
+			size_t bytes_saved = 0; // Blit traffic avoided by direct frames
 
-		static slcross::slang::session* get_session() {
-			static slcross::slang::session* session = slcross::slang::create_session();
-			return session;
-		}
+			void print_report(std::ostream& out, uint2 reference_size = {3840, 2160}, texture::format reference_format = texture::format::BGRA8_SRGB, size_t reference_fps = 60) const;
+		};
 
-		static void inject_default_virtual_filesystem();
+		texture target = {};
+		bool direct = false;
+		bool capture = false; // Forces the blit path so every frame lands in the gbuffer (ex. for a readback_ring)
+		statistics stats = {};
 
-		static std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> process_shaders(context& ctx, std::string_view content, const entry_points& eps, std::string_view module = "generated") {
-			inject_default_virtual_filesystem();
+		// A blit reads every texel of the source and writes every texel of the destination
+		static size_t blit_bytes(uint2 size, texture::format format) {
+			return 2 * gpu_memory_tracker::image_bytes(size, format);
+		}
 
-			std::vector<managable<STYLIZER_API_TYPE(shader)>> shaders; shaders.reserve(eps.size());
-			api::pipeline::entry_points api;
-			auto session = get_session();
+		static bool compatible(STYLIZER_API_NAMESPACE::texture& surface_texture, geometry_buffer& gbuffer) {
+			auto surface_size = surface_texture.get_size(), gbuffer_size = gbuffer.color.get_size();
+			return surface_texture.get_format() == gbuffer.config.color_format
+				&& surface_size.x == gbuffer_size.x && surface_size.y == gbuffer_size.y;
+		}
+
+		drawing_state begin_drawing(context& ctx, STYLIZER_API_TYPE(surface)& surface, geometry_buffer& gbuffer, float4 clear_color, optional<float> clear_depth = {}, bool one_shot = true) {
+			target = ctx.get_surface_texture(surface);
+			direct = !capture && compatible(target, gbuffer);
+			if(ctx.recorder) ctx.record_begin_pass(gbuffer.recording_id, direct ? &surface : nullptr, direct ? &target : nullptr, clear_color, clear_depth ? *clear_depth : 1, one_shot);
+			return gbuffer.begin_drawing_into(ctx, direct ? &target : nullptr, clear_color, clear_depth, one_shot);
+		}
+		drawing_state begin_drawing(context& ctx, STYLIZER_API_TYPE(surface)& surface, geometry_buffer& gbuffer, optional<float3> clear_color = {}, optional<float> clear_depth = {}, bool one_shot = true) {
+			return begin_drawing(ctx, surface, gbuffer, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, clear_depth, one_shot);
+		}
+		drawing_state begin_drawing(context& ctx, geometry_buffer& gbuffer, float4 clear_color, optional<float> clear_depth = {}, bool one_shot = true) {
+			return begin_drawing(ctx, ctx.surface, gbuffer, clear_color, clear_depth, one_shot);
+		}
+		drawing_state begin_drawing(context& ctx, geometry_buffer& gbuffer, optional<float3> clear_color = {}, optional<float> clear_depth = {}, bool one_shot = true) {
+			return begin_drawing(ctx, ctx.surface, gbuffer, clear_color, clear_depth, one_shot);
+		}
+
+		final_composite& present(context& ctx, STYLIZER_API_TYPE(surface)& surface, geometry_buffer& gbuffer) {
+			auto size = gbuffer.color.get_size();
+			if(direct) {
+				++stats.direct_frames;
+				stats.bytes_saved += blit_bytes(uint2(uint32_t(size.x), uint32_t(size.y)), gbuffer.config.color_format);
+			} else {
+				if(ctx.recorder) {
+					auto target_size = target.get_size();
+					ctx.record(command_recorder::opcode::Blit).write(gbuffer.recording_id).write(ctx.recorder->surface_id(&surface))
+						.write<uint32_t>(target_size.x).write<uint32_t>(target_size.y).write((uint32_t)target.get_format());
+				}
+				target.blit_from(ctx, gbuffer.color);
+				++stats.blit_frames;
+			}
+			if(ctx.recorder) ctx.record(command_recorder::opcode::Present).write(ctx.recorder->surface_id(&surface));
+			surface.present(ctx.device);
+			return *this;
+		}
+		final_composite& present(context& ctx, geometry_buffer& gbuffer) { return present(ctx, ctx.surface, gbuffer); }
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Viewport
+//////////////////////////////////////////////////////////////////////
+
+
+	// A surface (usually belonging to a secondary window) rendered by a shared context, materials
+	// created for one viewport's gbuffer can be used with every viewport that shares its formats
+	struct viewport {
+		STYLIZER_API_TYPE(surface) surface;
+		geometry_buffer gbuffer;
+		final_composite composite;
+		operator bool() { return surface || gbuffer; }
+
+		static viewport create_default(context& ctx, STYLIZER_API_TYPE(surface)&& surface, uint2 size, geometry_buffer::create_config config = {}) {
+			viewport out;
+			out.surface = std::move(surface);
+			out.gbuffer = geometry_buffer::create_default(ctx, size, config);
+			return out;
+		}
+
+		// Passes are recorded but not submitted, hand them to a frame_submission
+		drawing_state begin_drawing(context& ctx, float4 clear_color, optional<float> clear_depth = {}) {
+			return composite.begin_drawing(ctx, surface, gbuffer, clear_color, clear_depth, false);
+		}
+		drawing_state begin_drawing(context& ctx, optional<float3> clear_color = {}, optional<float> clear_depth = {}) {
+			return begin_drawing(ctx, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, clear_depth);
+		}
+
+		viewport& present(context& ctx) {
+			composite.present(ctx, surface, gbuffer);
+			return *this;
+		}
+
+		void release() {
+			gbuffer.release();
+			surface.release();
+		}
+	};
+
+	// Gathers the command buffers of every viewport's passes so a frame goes to the GPU in a single submission
+	struct frame_submission {
+		std::vector<STYLIZER_API_TYPE(command_buffer)> command_buffers;
+		std::vector<viewport*> viewports;
+
+		frame_submission& add(drawing_state& pass, STYLIZER_NULLABLE(viewport*) presents = nullptr) {
+			command_buffers.emplace_back(pass.end());
+			if(presents && std::find(viewports.begin(), viewports.end(), presents) == viewports.end())
+				viewports.emplace_back(presents);
+			return *this;
+		}
+		frame_submission& add(drawing_state&& pass, STYLIZER_NULLABLE(viewport*) presents = nullptr) { return add(pass, presents); }
+
+		// Viewports are presented after the submit so blit fallbacks see the finished gbuffers
+		void submit_and_present(context& ctx) {
+			if(ctx.recorder) ctx.record(command_recorder::opcode::Submit);
+			ctx.device.submit(command_buffers);
+			for(auto viewport: viewports)
+				viewport->present(ctx);
+			command_buffers.clear();
+			viewports.clear();
+		}
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Dynamic Resolution
+//////////////////////////////////////////////////////////////////////
+
+
+	struct dynamic_resolution_create_config {
+		float target_frame_time = 1 / 60.f; // Seconds
+		float min_scale = .5, max_scale = 1;
+		float max_step = .05; // Largest change in scale per frame
+		float smoothing = .1; // Weight of the newest frame in the frame time average
+		float headroom = .9; // Only scale back up once frames come in under this fraction of the target
+		float dead_band = .05; // Frames over the target by less than this fraction still count as on target
+	};
+
+	// Renders into a viewport of the (full size) gbuffer scaled by measured frame time,
+	// the rendered region is then stretched over the surface during the final composite.
+	// Frame time is the work between presents (time blocked on vsync isn't counted) unless the present to present
+	// interval missed the target, then the whole interval is used so stalls waiting on the GPU are seen too
+	struct dynamic_resolution {
+		using create_config = dynamic_resolution_create_config;
+		using clock = std::chrono::steady_clock;
+
+		create_config config = {};
+		float scale = 1;
+		float average_frame_time = 0;
+		clock::time_point work_start = {}, present_start = {};
+		clock::duration last_frame_time = {};
+
+		STYLIZER_API_TYPE(render_pipeline) upscale_pipeline = {};
+		std::vector<managable<STYLIZER_API_TYPE(shader)>> upscale_shaders;
+		texture::format upscale_format = {};
+		tracked<STYLIZER_API_TYPE(buffer)> uniforms;
+		texture target = {};
+
+		static dynamic_resolution create(context& ctx, create_config config = {}) {
+			using namespace api::operators;
+
+			dynamic_resolution out;
+			out.config = config;
+			out.scale = config.max_scale;
+			out.uniforms = ctx.create_buffer({
+				.label = "Stylizer Dynamic Resolution Uniforms",
+				.usage = api::usage::Uniform | api::usage::CopyDestination,
+				.size = sizeof(std::array<float, 4>)
+			}, "dynamic_resolution");
+			return out;
+		}
+
+		// Feeds a frame time to the controller and returns the new scale
+		float update(clock::duration frame_time) {
+			float seconds = std::chrono::duration<float>(frame_time).count();
+			average_frame_time = average_frame_time == 0 ? seconds : std::lerp(average_frame_time, seconds, config.smoothing);
+
+			float step = 0;
+			if(average_frame_time > config.target_frame_time * (1 + config.dead_band))
+				step = -config.max_step * std::min((average_frame_time - config.target_frame_time) / config.target_frame_time * 4, 1.f);
+			else if(average_frame_time < config.target_frame_time * config.headroom)
+				step = config.max_step * .5f; // Recover slower than we back off to avoid oscillating
+			scale = std::clamp(scale + step, config.min_scale, config.max_scale);
+			return scale;
+		}
+		// Feeds the frame time measured by the last present (if any hasn't been fed yet)
+		float update() {
+			auto frame_time = std::exchange(last_frame_time, clock::duration{});
+			return frame_time == clock::duration{} ? scale : update(frame_time);
+		}
+
+		uint2 render_size(geometry_buffer& gbuffer) const {
+			auto size = gbuffer.color.get_size();
+			return {std::max<uint32_t>(size.x * scale, 1), std::max<uint32_t>(size.y * scale, 1)};
+		}
+
+		drawing_state begin_drawing(context& ctx, geometry_buffer& gbuffer, float4 clear_color, optional<float> clear_depth = {}, bool one_shot = true) {
+			auto pass = gbuffer.begin_drawing(ctx, clear_color, clear_depth, one_shot);
+			pass.set_viewport(ctx, uint2{0, 0}, render_size(gbuffer));
+			return pass;
+		}
+		drawing_state begin_drawing(context& ctx, geometry_buffer& gbuffer, optional<float3> clear_color = {}, optional<float> clear_depth = {}, bool one_shot = true) {
+			return begin_drawing(ctx, gbuffer, clear_color ? float4(*clear_color, 1) : float4{0, 0, 0, 1}, clear_depth, one_shot);
+		}
+
+		// Blits when rendering at full size, otherwise upscales the rendered region onto the surface
+		dynamic_resolution& present(context& ctx, STYLIZER_API_TYPE(surface)& surface, geometry_buffer& gbuffer);
+		dynamic_resolution& present(context& ctx, geometry_buffer& gbuffer) { return present(ctx, ctx.surface, gbuffer); }
+
+		// Stretches the top left source sized region of the gbuffer over the target (not recorded, present records it)
+		dynamic_resolution& upscale(context& ctx, texture& target, geometry_buffer& gbuffer, uint2 source);
+
+		void release() {
+			if(upscale_pipeline) upscale_pipeline.release();
+			for(auto& shader: upscale_shaders)
+				if(shader.is_managed) shader->release();
+			upscale_shaders.clear();
+			uniforms.release();
+		}
+
+	protected:
+		void create_upscale_pipeline(context& ctx, texture& target);
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Readback
+//////////////////////////////////////////////////////////////////////
+
+
+	struct readback_ring_create_config {
+		size_t slots = 3;
+		std::string_view label = "Stylizer Readback Buffer";
+	};
+
+	// Ring of mappable buffers which lets texture contents flow back to the CPU without stalling;
+	// each request copies into a free slot and the mapping resolves in a later context::process_events
+	struct readback_ring {
+		using create_config = readback_ring_create_config;
+
+		// Zero-copy view of a mapped slot, valid until handed back with readback_ring::release_view
+		struct view {
+			std::span<const std::byte> data;
+			size_t row_stride = 0; // Rows are padded to satisfy the API's copy alignment
+			uint2 size = {};
+			texture::format format;
+			size_t frame = 0;
+			size_t slot = 0;
+
+			std::span<const std::byte> row(size_t y) const {
+				return data.subspan(y * row_stride, gpu_memory_tracker::row_bytes(size.x, format));
+			}
+		};
+
+		struct statistics {
+			using clock = std::chrono::steady_clock;
+
+			size_t requested = 0, completed = 0, dropped = 0; // Dropped requests found no free slot
+			size_t bytes = 0;
+			clock::duration total_latency = {}, max_latency = {};
+			clock::time_point first_request = {}, last_completion = {};
+
+			double frames_per_second() const {
+				auto seconds = std::chrono::duration<double>(last_completion - first_request).count();
+				return seconds > 0 ? completed / seconds : 0;
+			}
+			double bytes_per_second() const {
+				auto seconds = std::chrono::duration<double>(last_completion - first_request).count();
+				return seconds > 0 ? bytes / seconds : 0;
+			}
+			clock::duration average_latency() const { return completed ? total_latency / clock::duration::rep(completed) : clock::duration{}; }
+
+			void print_report(std::ostream& out) const;
+		};
+
+		struct slot {
+			enum class status { Free, Pending, Ready, Held };
+
+			tracked<STYLIZER_API_TYPE(buffer)> buffer;
+			status state = status::Free;
+			std::future<std::byte*> mapping;
+			std::byte* data = nullptr;
+			size_t frame = 0;
+			statistics::clock::time_point requested = {};
+		};
+
+		uint2 size = {};
+		texture::format format;
+		size_t row_stride = 0;
+		std::vector<slot> slots;
+		size_t next_frame = 0;
+		statistics stats = {};
+
+		static constexpr size_t row_alignment = 256;
+		static size_t aligned_row_stride(uint2 size, texture::format format) {
+			auto bytes = gpu_memory_tracker::row_bytes(size.x, format);
+			return (bytes + row_alignment - 1) / row_alignment * row_alignment;
+		}
+
+		static readback_ring create(context& ctx, uint2 size, texture::format format, create_config config = {}) {
+			using namespace api::operators;
+
+			readback_ring out;
+			out.size = size;
+			out.format = format;
+			out.row_stride = aligned_row_stride(size, format);
+			out.slots.resize(std::max<size_t>(config.slots, 1));
+			for(auto& slot: out.slots)
+				slot.buffer = ctx.create_buffer({
+					.label = config.label,
+					.usage = api::usage::MapRead | api::usage::CopyDestination,
+					.size = out.buffer_size()
+				}, "readback", false); // Read backs aren't part of a trace
+			return out;
+		}
+		// NOTE: Gbuffers drawn through a final_composite should use create_for_final_composite
+		static readback_ring create_for_geometry_buffer(context& ctx, geometry_buffer& gbuffer, create_config config = {}) {
+			auto size = gbuffer.color.get_size();
+			return create(ctx, uint2(uint32_t(size.x), uint32_t(size.y)), gbuffer.config.color_format, config);
+		}
+		// Direct frames skip the gbuffer and surface textures can't be copied from, so this switches the
+		// composite to its blit path, clear composite.capture once done reading back
+		static readback_ring create_for_final_composite(context& ctx, final_composite& composite, geometry_buffer& gbuffer, create_config config = {}) {
+			composite.capture = true;
+			return create_for_geometry_buffer(ctx, gbuffer, config);
+		}
+
+		size_t buffer_size() const { return row_stride * gpu_memory_tracker::row_count(size.y, format); }
+
+		// Returns false (and counts a dropped frame) if every slot is still in flight
+		bool request(context& ctx, STYLIZER_API_NAMESPACE::texture& source) {
+			auto now = statistics::clock::now();
+			if(stats.requested++ == 0) stats.first_request = now;
+
+			auto free = std::find_if(slots.begin(), slots.end(), [](const slot& s) { return s.state == slot::status::Free; });
+			if(free == slots.end()) {
+				++stats.dropped;
+				return false;
+			}
+
+			assert(source.get_size().x == size.x && source.get_size().y == size.y && source.get_format() == format);
+			source.copy_to_buffer(ctx, free->buffer, row_stride, api::convert(uint3(size, 1)));
+			free->mapping = free->buffer.map_async(ctx, false, 0, buffer_size());
+			free->state = slot::status::Pending;
+			free->frame = next_frame++;
+			free->requested = now;
+			return true;
+		}
+
+		// Returns the oldest finished frame (if any) without blocking
+		optional<view> poll(context& ctx) {
+			ctx.process_events();
+			resolve_mappings();
+			return take_oldest();
+		}
+
+		// Blocks until a frame finishes, only useful at shutdown or when nothing else can be done
+		optional<view> wait(context& ctx) {
+			if(!any_pending()) return {};
+
+			while(true)
+				if(auto out = poll(ctx); out) return out;
+		}
+
+		// Completes with the oldest frame once one finishes, without blocking the render thread
+		// NOTE: The ring must not move while the task is pending
+		task<optional<view>> next_async(context& ctx) {
+			if(!any_pending()) co_return optional<view>{};
+			co_await ctx.scheduler->until([this] {
+				resolve_mappings();
+				return std::any_of(slots.begin(), slots.end(), [](const slot& s) { return s.state == slot::status::Ready; });
+			});
+			co_return take_oldest();
+		}
+
+		readback_ring& release_view(const view& view) {
+			auto& slot = slots[view.slot];
+			assert(slot.state == slot::status::Held);
+			slot.buffer.unmap();
+			slot.data = nullptr;
+			slot.state = slot::status::Free;
+			return *this;
+		}
+
+		void release() {
+			for(auto& slot: slots) {
+				if(slot.state == slot::status::Ready || slot.state == slot::status::Held)
+					slot.buffer.unmap();
+				slot.buffer.release();
+			}
+			slots.clear();
+		}
+
+	protected:
+		bool any_pending() const {
+			return std::any_of(slots.begin(), slots.end(), [](const slot& s) {
+				return s.state == slot::status::Pending || s.state == slot::status::Ready;
+			});
+		}
+
+		optional<view> take_oldest() {
+			slot* oldest = nullptr;
+			for(auto& slot: slots)
+				if(slot.state == slot::status::Ready && (!oldest || slot.frame < oldest->frame))
+					oldest = &slot;
+			if(!oldest) return {};
+
+			oldest->state = slot::status::Held;
+			return view{
+				.data = {oldest->data, buffer_size()},
+				.row_stride = row_stride,
+				.size = size,
+				.format = format,
+				.frame = oldest->frame,
+				.slot = size_t(oldest - slots.data())
+			};
+		}
+
+		void resolve_mappings() {
+			using namespace std::chrono_literals;
+			for(auto& slot: slots) {
+				if(slot.state != slot::status::Pending) continue;
+				if(slot.mapping.wait_for(0s) != std::future_status::ready) continue;
+
+				slot.data = slot.mapping.get();
+				slot.state = slot::status::Ready;
+
+				auto now = statistics::clock::now();
+				auto latency = now - slot.requested;
+				++stats.completed;
+				stats.bytes += gpu_memory_tracker::image_bytes(size, format);
+				stats.total_latency += latency;
+				stats.max_latency = std::max(stats.max_latency, latency);
+				stats.last_completion = now;
+			}
+		}
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Vertex Layout
+//////////////////////////////////////////////////////////////////////
+
+
+	using vertex_attribute_format = std::remove_cv_t<decltype(api::vertex_buffer_type_format<float1>::format)>;
+
+	struct vertex_attribute_description {
+		vertex_attribute_format format;
+		size_t offset;
+	};
+
+	#define STYLIZER_VERTEX_ATTRIBUTE(type, member) stylizer::vertex_attribute_description{\
+		stylizer::api::vertex_buffer_type_format<decltype(type::member)>::format,\
+		offsetof(type, member)\
+	}
+
+	// Attribute i is bound to shader location i, stride is always sizeof(Vertex)
+	template<typename Vertex, size_t N>
+	struct vertex_layout_description {
+		std::array<vertex_attribute_description, N> attributes;
+		bool per_instance = false;
+
+		static constexpr size_t stride = sizeof(Vertex);
+		static constexpr size_t attribute_count = N;
+	};
+
+	template<typename Vertex, typename... Attributes>
+	constexpr vertex_layout_description<Vertex, sizeof...(Attributes)> make_vertex_layout(Attributes... attributes) {
+		return {{attributes...}};
+	}
+
+	template<typename Vertex, typename... Attributes>
+	constexpr vertex_layout_description<Vertex, sizeof...(Attributes)> make_instance_layout(Attributes... attributes) {
+		return {{attributes...}, true};
+	}
+
+	// Specialize for each vertex type, ex:
+	// template<> constexpr auto stylizer::vertex_layout_v<vertex> = stylizer::make_vertex_layout<vertex>(
+	// 	STYLIZER_VERTEX_ATTRIBUTE(vertex, position), STYLIZER_VERTEX_ATTRIBUTE(vertex, uv));
+	template<typename Vertex>
+	constexpr auto vertex_layout_v = nullptr;
+
+	template<typename Vertex>
+	concept has_vertex_layout = !std::is_same_v<std::remove_cv_t<decltype(vertex_layout_v<Vertex>)>, std::nullptr_t>;
+
+	template<has_vertex_layout Vertex>
+	struct vertex_layout {
+		static constexpr auto& description = vertex_layout_v<Vertex>;
+
+		static_assert([]{
+			for(auto& attribute: description.attributes)
+				if(attribute.offset >= description.stride) return false;
+			return true;
+		}(), "Vertex attribute offsets must fall inside the vertex");
+
+		// Built once per vertex type, material creation only copies it into the pipeline config
+		static const api::render_pipeline::config::vertex_buffer_layout& get() {
+			using attribute = api::render_pipeline::config::vertex_buffer_layout::attribute;
+			static const std::vector<attribute> attributes = []{
+				std::vector<attribute> out; out.reserve(description.attribute_count);
+				for(size_t i = 0; i < description.attribute_count; ++i)
+					out.push_back({
+						.format = description.attributes[i].format,
+						.offset = description.attributes[i].offset,
+						.shader_location = i
+					});
+				return out;
+			}();
+			static const api::render_pipeline::config::vertex_buffer_layout layout = {
+				.per_element_size = description.stride,
+				.per_instance = description.per_instance,
+				.attributes = {attributes.begin(), attributes.end()}
+			};
+			return layout;
+		}
+	};
+
+	template<has_vertex_layout... Vertices>
+	api::render_pipeline::config pipeline_config_for_vertices(api::render_pipeline::config config = {}) {
+		config.vertex_buffers = {vertex_layout<Vertices>::get()...};
+		return config;
+	}
+
+
+//////////////////////////////////////////////////////////////////////
+// # Material
+//////////////////////////////////////////////////////////////////////
+
+
+	struct shader_processor {
+		using entry_points = std::unordered_map<api::shader::stage, std::string_view>;
+		using vertex_buffer_layout = api::render_pipeline::config::vertex_buffer_layout;
+
+		struct vertex_layout_mismatch : public std::runtime_error {
+			using std::runtime_error::runtime_error;
+		};
+
+		struct vertex_input {
+			size_t location;
+			size_t components;
+			std::string name;
+		};
+
+		static slcross::slang::session* get_session() {
+			static slcross::slang::session* session = slcross::slang::create_session();
+			return session;
+		}
+		// Slang sessions aren't thread safe, hold this around every use of get_session
+		static std::mutex& session_mutex() {
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		static void inject_default_virtual_filesystem();
+
+		// Reads the location decorated inputs of a vertex stage straight from its SPIR-V
+		static std::vector<vertex_input> reflect_vertex_inputs(std::span<const uint32_t> spirv);
+		// Throws vertex_layout_mismatch if the vertex inputs can't be fed by the provided layouts
+		static void validate_vertex_inputs(std::span<const uint32_t> spirv, std::span<const vertex_buffer_layout> layouts, std::string_view entry_point = "vertex");
+
+		using compiled_shaders = std::vector<std::pair<api::shader::stage, std::vector<uint32_t>>>;
+
+		static std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> process_shaders(context& ctx, std::string_view content, const entry_points& eps, std::string_view module = "generated", optional<std::span<const vertex_buffer_layout>> validate_against = {}) {
+			return process_shaders<entry_points>(ctx, content, eps, module, validate_against);
+		}
+		// Accepts any range of (stage, entry point name) pairs so callers can avoid building a node based map
+		template<std::ranges::sized_range EntryPoints>
+		static std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> process_shaders(context& ctx, std::string_view content, const EntryPoints& eps, std::string_view module = "generated", optional<std::span<const vertex_buffer_layout>> validate_against = {}) {
+			return create_shaders(ctx, compile(content, eps, module, validate_against));
+		}
+
+		// The CPU only half of process_shaders, safe to call from any thread
+		template<std::ranges::sized_range EntryPoints>
+		static compiled_shaders compile(std::string_view content, const EntryPoints& eps, std::string_view module = "generated", optional<std::span<const vertex_buffer_layout>> validate_against = {}) {
+			compiled_shaders out; out.reserve(std::ranges::size(eps));
 			auto path = std::string{module} + ".slang";
 			for(auto& [stage, ep]: eps) {
-				auto spirv = slcross::glsl::canonicalize(
-					slcross::slang::parse_from_memory(session, content, ep, path, module), 
-					api::shader::to_slcross(stage)
-				);
+				std::vector<uint32_t> spirv;
+				{
+					std::scoped_lock lock(session_mutex());
+					inject_default_virtual_filesystem();
+					spirv = slcross::glsl::canonicalize(
+						slcross::slang::parse_from_memory(get_session(), content, ep, path, module), 
+						api::shader::to_slcross(stage)
+					);
+				}
 				assert(spirv.size());
+				if(validate_against && stage == api::shader::stage::Vertex)
+					validate_vertex_inputs(spirv, *validate_against, ep);
+				out.emplace_back(stage, std::move(spirv));
+			}
+			return out;
+		}
+		// Compiles on the thread_pool, the task completes on whichever pool thread finished compiling
+		// NOTE: The entry point names must outlive the task
+		static task<compiled_shaders> compile_async(std::string_view content, const entry_points& eps, std::string_view module = "generated", std::span<const vertex_buffer_layout> validate_against = {}) {
+			return compile_async_impl(std::string{content}, eps, std::string{module}, {validate_against.begin(), validate_against.end()});
+		}
+
+		static std::pair<std::vector<managable<STYLIZER_API_TYPE(shader)>>, api::pipeline::entry_points> create_shaders(context& ctx, compiled_shaders compiled) {
+			std::vector<managable<STYLIZER_API_TYPE(shader)>> shaders; shaders.reserve(compiled.size());
+			api::pipeline::entry_points api;
+			for(auto& [stage, spirv]: compiled) {
 				shaders.emplace_back(true, ctx.device.create_shader_from_spirv(std::move(spirv)));
 				api.emplace(stage, api::pipeline::entry_point{.shader = &shaders.back().value});
 			}
 			return {std::move(shaders), api};
 		}
+
+	protected:
+		// Coroutine parameters are copied into the frame, so the async entry points hand over owned strings
+		static task<compiled_shaders> compile_async_impl(std::string content, entry_points eps, std::string module, std::vector<vertex_buffer_layout> validate_against) {
+			co_await coroutine_scheduler::on_pool();
+			co_return compile(content, eps, module, validate_against.empty() ? optional<std::span<const vertex_buffer_layout>>{} : std::span<const vertex_buffer_layout>{validate_against});
+		}
 	};
 
 
+	// Bind group entry which an active command_recorder can capture, the resource must come from context::create_buffer/create_texture
+	struct material_binding {
+		std::variant<tracked<STYLIZER_API_TYPE(buffer)>*, tracked<texture>*> resource;
+		size_t offset = 0; // Buffers only
+		std::optional<size_t> size = {}; // Buffers only
+		std::optional<bool> sampled = {}; // Textures only
+	};
+
+	struct material_bind_group {
+		STYLIZER_API_TYPE(bind_group) group;
+		uint32_t recording_id = 0;
+
+		operator bool() { return group; }
+		void release() { group.release(); }
+	};
+
 	struct material {
 		STYLIZER_API_TYPE(render_pipeline) pipeline = {};
 		std::vector<managable<STYLIZER_API_TYPE(shader)>> shaders;
 		std::vector<managable<STYLIZER_API_TYPE(buffer)>> buffers;
 		std::vector<managable<texture>> textures;
+		std::deque<tracked<STYLIZER_API_TYPE(buffer)>> owned_buffers; // Created through the material, a deque so references stay valid
+		std::deque<tracked<texture>> owned_textures;
+		uint32_t recording_id = 0;
 
 		operator bool() { return pipeline; }
 
@@ -279,22 +1813,61 @@ namespace stylizer {
 		}
 		material& upload_from_shaders_for_geometry_buffer(context& ctx, const api::pipeline::entry_points& entry_points, geometry_buffer& gbuffer, const api::render_pipeline::config& config = {}) {
 			if(pipeline) pipeline.release();
-			auto_release pass = gbuffer.begin_drawing(ctx);
+			auto_release pass = gbuffer.begin_drawing_into(ctx, nullptr, float4{0, 0, 0, 1}); // Not recorded, only used to describe the attachments
 			pipeline = ctx.device.create_render_pipeline_from_compatible_render_pass(entry_points, pass, config, "Stylizer Default Material Pipeline");
 			return *this;
 		}
 
 		material& upload_from_source(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, std::string_view module = "generated", std::span<const api::color_attachment> color_attachments = {}, const std::optional<api::depth_stencil_attachment>& depth_attachment = {}, const api::render_pipeline::config& config = {}) {
-			auto [shaders, eps] = shader_processor::process_shaders(ctx, content, entry_points, module);
+			auto [shaders, eps] = shader_processor::process_shaders(ctx, content, entry_points, module, std::span<const shader_processor::vertex_buffer_layout>{config.vertex_buffers});
 			release_shaders();
 			this->shaders = std::move(shaders);
 			return upload_from_shaders(ctx, eps, color_attachments, depth_attachment, config);
 		}
-		material& upload_from_source_for_geometry_buffer(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module = "generated", const api::render_pipeline::config& config = {}) {
-			auto [shaders, eps] = shader_processor::process_shaders(ctx, content, entry_points, module);
-			release_shaders();
-			this->shaders = std::move(shaders);
-			return upload_from_shaders_for_geometry_buffer(ctx, eps, gbuffer, config);
+		// Takes the pipeline (or just the shaders) prewarmed by context::pipelines when there is one
+		material& upload_from_source_for_geometry_buffer(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module = "generated", const api::render_pipeline::config& config = {});
+
+		// Compiles on the thread_pool, then creates the shaders and pipeline back on the render thread (in context::process_events)
+		// NOTE: The entry point names and geometry buffer must outlive the task
+		static task<material> create_from_source_for_geometry_buffer_async(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module = "generated", const api::render_pipeline::config& config = {}) {
+			return create_from_source_for_geometry_buffer_async_impl(ctx, std::string{content}, entry_points, gbuffer, std::string{module}, config);
+		}
+
+		void record_creation(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module, const api::render_pipeline::config& config) {
+			recording_id = ctx.recorder->new_id();
+			auto& record = ctx.record(command_recorder::opcode::CreateMaterial).write(recording_id).write(gbuffer.recording_id)
+				.write(module).write(content).write<uint32_t>(entry_points.size());
+			for(auto& [stage, name]: entry_points)
+				record.write<uint32_t>((uint32_t)stage).write(name);
+			record.write_value(config);
+		}
+
+		// Created resources are owned by (and released with) the material, they are tracked under "material"
+		tracked<STYLIZER_API_TYPE(buffer)>& create_buffer(context& ctx, const STYLIZER_API_TYPE(buffer)::create_config& config) {
+			return owned_buffers.emplace_back(ctx.create_buffer(config, "material"));
+		}
+		tracked<texture>& create_texture(context& ctx, const texture::create_config& config) {
+			return owned_textures.emplace_back(ctx.create_texture(config, "material"));
+		}
+
+		material_bind_group create_bind_group(context& ctx, size_t index, std::span<const material_binding> bindings) {
+			std::vector<api::bind_group::binding> api_bindings; api_bindings.reserve(bindings.size());
+			for(auto& binding: bindings)
+				if(auto buffer = std::get_if<0>(&binding.resource))
+					api_bindings.emplace_back(api::bind_group::buffer_binding{.buffer = *buffer, .offset = binding.offset, .size = binding.size});
+				else api_bindings.emplace_back(api::bind_group::texture_binding{.texture = std::get<1>(binding.resource), .sampled = binding.sampled});
+
+			material_bind_group out{pipeline.create_bind_group(ctx, index, api_bindings)};
+			if(ctx.recorder) {
+				out.recording_id = ctx.recorder->new_id();
+				auto& record = ctx.record(command_recorder::opcode::CreateBindGroup).write(out.recording_id).write(recording_id)
+					.write<uint32_t>(index).write<uint32_t>(bindings.size());
+				for(auto& binding: bindings) {
+					auto id = std::visit([](auto* resource) { return resource->recording_id; }, binding.resource);
+					record.write<uint8_t>(binding.resource.index()).write(id).write<uint64_t>(binding.offset).write_value(binding.size).write_value(binding.sampled);
+				}
+			}
+			return out;
 		}
 
 		void release_shaders() {
@@ -309,8 +1882,233 @@ namespace stylizer {
 				if(buffer.is_managed) buffer->release();
 			for(auto& texture: textures)
 				if(texture.is_managed) texture->release();
+			for(auto& buffer: owned_buffers) buffer.release();
+			for(auto& texture: owned_textures) texture.release();
+			owned_buffers.clear();
+			owned_textures.clear();
 		}
+
+	protected:
+		static task<material> create_from_source_for_geometry_buffer_async_impl(context& ctx, std::string content, shader_processor::entry_points entry_points, geometry_buffer& gbuffer, std::string module, api::render_pipeline::config config);
+		bool take_prewarmed(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module, const api::render_pipeline::config& config);
 	};
 
+	inline drawing_state& drawing_state::bind_material(struct context& ctx, struct material& material) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::BindMaterial).write(material.recording_id);
+		super::bind_render_pipeline(ctx.device, material.pipeline);
+		return *this;
+	}
+	inline drawing_state& drawing_state::bind_group(struct context& ctx, material_bind_group& group) {
+		if(ctx.recorder) ctx.record(command_recorder::opcode::BindGroup).write(group.recording_id);
+		super::bind_render_group(ctx.device, group.group);
+		return *this;
+	}
+
+
+//////////////////////////////////////////////////////////////////////
+// # Pipeline Manifest
+//////////////////////////////////////////////////////////////////////
+
+
+	// Every material pipeline created during a run (from source, for a geometry buffer), saved so the
+	// next run can compile all their shaders on the thread_pool and build the pipelines before they are first needed.
+	// Only SPIR-V is compiled off thread, shader modules and pipelines are created by build_pipelines on the
+	// render thread against stand-in attachments of the recorded formats, so nothing GPU side is touched off thread
+	struct pipeline_manifest {
+		using clock = std::chrono::steady_clock;
+
+		static constexpr std::array<char, 8> magic = {'S', 'T', 'Y', 'L', 'P', 'I', 'P', 'E'};
+		static constexpr uint32_t version = 3;
+
+		// Everything compilation and pipeline creation depend on
+		struct entry {
+			std::string module, source;
+			std::vector<std::pair<api::shader::stage, std::string>> entry_points;
+			std::vector<texture::format> color_formats; // Of the geometry buffer's attachments
+			optional<texture::format> depth_format;
+			std::vector<std::byte> config; // The render_pipeline::config as written by command_recorder::write_value
+
+			// Spans in the returned config point into storage owned by the reader
+			api::render_pipeline::config read_config(command_stream_reader& reader) const {
+				reader = {config, 0, {}};
+				api::render_pipeline::config out{};
+				reader.read_value(out);
+				return out;
+			}
+
+			std::vector<std::byte> serialize() const;
+			uint64_t hash() const { return hash_bytes(serialize()); }
+		};
+
+		struct statistics {
+			size_t loaded = 0, recorded = 0; // Recorded counts pipelines first seen this run
+			size_t prewarmed = 0, built = 0, failed = 0;
+			size_t ready = 0; // Pipelines which were already built when first needed
+			size_t hits = 0, waited = 0, misses = 0; // Hits only had their shaders prewarmed, waited hits were still compiling when first needed
+			clock::duration prewarm_time = {}; // Summed over the pipelines which were taken over
+			clock::duration time_saved = {}; // Compilation and creation time moved off the first use
+
+			void print_report(std::ostream& out) const;
+		};
+
+		// Made by build_pipelines, handed over to the material whose description matches
+		struct built_pipeline {
+			std::vector<managable<STYLIZER_API_TYPE(shader)>> shaders;
+			STYLIZER_API_TYPE(render_pipeline) pipeline = {};
+			clock::duration creation_time = {}; // Compilation included
+		};
+
+		std::vector<entry> entries;
+		std::unordered_map<uint64_t, size_t> index; // Hash -> entry
+		statistics stats = {};
+
+		static entry describe(std::string_view content, const shader_processor::entry_points& entry_points, std::string_view module, geometry_buffer& gbuffer, const api::render_pipeline::config& config) {
+			entry out{std::string{module}, std::string{content}, {}, {}, {}, {}};
+			for(auto& [stage, name]: entry_points) out.entry_points.emplace_back(stage, name);
+			std::ranges::sort(out.entry_points, {}, [](auto& ep) { return (uint32_t)ep.first; }); // Hash independent of map order
+
+			for(auto& attachment: gbuffer.color_attachments()) out.color_formats.push_back(attachment.texture->get_format());
+			if(auto depth = gbuffer.depth_attachment()) out.depth_format = depth->texture->get_format();
+			command_recorder writer;
+			writer.stream.clear(); // Only the value, not a stream header
+			out.config = std::move(writer.write_value(config).stream);
+			return out;
+		}
+
+		// Returns false if the shaders were already in the manifest
+		bool record(entry e, uint64_t hash) {
+			std::scoped_lock lock(mutex);
+			if(index.contains(hash)) return false;
+			index[hash] = entries.size();
+			entries.emplace_back(std::move(e));
+			++stats.recorded;
+			return true;
+		}
+
+		// Merges a saved manifest into this one
+		bool load(const std::filesystem::path& path);
+		bool save(const std::filesystem::path& path) const;
+
+		// Starts compiling every entry in the manifest on the thread_pool, returns immediately
+		void prewarm();
+		// Creates the shaders and pipeline of every prewarmed entry (waiting for their compiles),
+		// call on the render thread at startup (ex. behind a loading screen) after prewarm
+		void build_pipelines(context& ctx);
+
+		// Hands over a pipeline made by build_pipelines along with its shaders, each is only handed out once
+		optional<built_pipeline> take_pipeline(uint64_t hash);
+		// Hands over prewarmed SPIR-V (waiting for it if it is still compiling), each is only handed out once
+		optional<shader_processor::compiled_shaders> take(uint64_t hash);
+
+		// Blocks until every prewarm task is done and drops the results and pipelines nobody took
+		void release();
+
+	protected:
+		struct prewarmed {
+			shader_processor::compiled_shaders compiled;
+			clock::duration compile_time;
+		};
+
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::future<prewarmed>> pending;
+		std::unordered_map<uint64_t, built_pipeline> built;
+	};
+
+	inline material& material::upload_from_source_for_geometry_buffer(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module /* = "generated" */, const api::render_pipeline::config& config /* = {} */) {
+		if(ctx.recorder) record_creation(ctx, content, entry_points, gbuffer, module, config);
+		if(take_prewarmed(ctx, content, entry_points, gbuffer, module, config)) return *this;
+
+		auto [shaders, eps] = shader_processor::process_shaders(ctx, content, entry_points, module, std::span<const shader_processor::vertex_buffer_layout>{config.vertex_buffers});
+		release_shaders();
+		this->shaders = std::move(shaders);
+		return upload_from_shaders_for_geometry_buffer(ctx, eps, gbuffer, config);
+	}
+
+	inline task<material> material::create_from_source_for_geometry_buffer_async_impl(context& ctx, std::string content, shader_processor::entry_points entry_points, geometry_buffer& gbuffer, std::string module, api::render_pipeline::config config) {
+		material out{};
+		if(ctx.recorder) out.record_creation(ctx, content, entry_points, gbuffer, module, config);
+		if(out.take_prewarmed(ctx, content, entry_points, gbuffer, module, config)) co_return out;
+
+		auto compiled = co_await shader_processor::compile_async(content, entry_points, module, config.vertex_buffers);
+		co_await ctx.scheduler->on_render_thread();
+
+		auto [shaders, eps] = shader_processor::create_shaders(ctx, std::move(compiled));
+		out.shaders = std::move(shaders);
+		out.upload_from_shaders_for_geometry_buffer(ctx, eps, gbuffer, config);
+		co_return out;
+	}
+
+	inline bool material::take_prewarmed(context& ctx, std::string_view content, const shader_processor::entry_points& entry_points, geometry_buffer& gbuffer, std::string_view module, const api::render_pipeline::config& config) {
+		if(!ctx.pipelines) return false;
+
+		auto description = pipeline_manifest::describe(content, entry_points, module, gbuffer, config);
+		auto hash = description.hash();
+		ctx.pipelines->record(std::move(description), hash);
+		if(auto built = ctx.pipelines->take_pipeline(hash)) {
+			release_shaders();
+			this->shaders = std::move(built->shaders);
+			if(pipeline) pipeline.release();
+			pipeline = std::move(built->pipeline);
+			return true;
+		}
+
+		auto compiled = ctx.pipelines->take(hash);
+		if(!compiled) return false;
+
+		auto [shaders, eps] = shader_processor::create_shaders(ctx, std::move(*compiled));
+		release_shaders();
+		this->shaders = std::move(shaders);
+		upload_from_shaders_for_geometry_buffer(ctx, eps, gbuffer, config);
+		return true;
+	}
+
+
+//////////////////////////////////////////////////////////////////////
+// # Async
+//////////////////////////////////////////////////////////////////////
+
+
+	inline task<> context::submitted_work_done() {
+		using namespace api::operators;
+		auto scheduler = this->scheduler;
+
+		// Writing the fence queues it behind all prior work, so its mapping only resolves once that work is done
+		tracked<STYLIZER_API_TYPE(buffer)> fence;
+		if(scheduler->fences.empty())
+			fence = create_buffer({
+				.label = "Stylizer Fence Buffer",
+				.usage = api::usage::MapRead | api::usage::CopyDestination,
+				.size = sizeof(uint32_t)
+			}, "fence");
+		else {
+			fence = std::move(scheduler->fences.back());
+			scheduler->fences.pop_back();
+		}
+		uint32_t value = 0;
+		fence.write(device, std::as_bytes(std::span{&value, 1}));
+
+		co_await scheduler->wait(fence.map_async(device, false, 0, sizeof(value)));
+		fence.unmap();
+		scheduler->fences.emplace_back(std::move(fence));
+	}
+
+	inline void context::release(bool static_sub_objects /* = false */) {
+		// Everything core owns (ex. recycled fences) is released first so only the caller's leaks are reported
+		if(pipelines) pipelines->release();
+		if(scheduler) scheduler->release();
+		recorder = nullptr;
+		if(memory) memory->print_leak_report(std::cerr);
+		device.release(static_sub_objects);
+		surface.release();
+	}
+
+	// Drives the task to completion by pumping context::process_events, the blocking bridge for code which isn't a coroutine
+	template<typename T>
+	T sync_wait(context& ctx, task<T> task) {
+		task.start();
+		while(!task.done()) ctx.process_events();
+		return task.get();
+	}
+
 
 } // namespace stylizer
\ No newline at end of file
@@ -0,0 +1,558 @@
+#include "geometry.hpp"
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+namespace stylizer {
+
+	namespace {
+		struct vec3 {
+			float x = 0, y = 0, z = 0;
+
+			vec3() = default;
+			vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+			vec3(const float3& v) : x(float(v.x)), y(float(v.y)), z(float(v.z)) {}
+			operator float3() const { return float3(x, y, z); }
+
+			vec3 operator+(vec3 o) const { return {x + o.x, y + o.y, z + o.z}; }
+			vec3 operator-(vec3 o) const { return {x - o.x, y - o.y, z - o.z}; }
+			vec3 operator*(float s) const { return {x * s, y * s, z * s}; }
+		};
+		float dot(vec3 a, vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		vec3 cross(vec3 a, vec3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+		float length(vec3 v) { return std::sqrt(dot(v, v)); }
+		vec3 normalize(vec3 v) {
+			auto l = length(v);
+			return l > 0 ? v * (1 / l) : vec3{};
+		}
+
+		// Symmetric 4x4 matrix summing (weighted) squared distances to a set of planes
+		struct quadric {
+			double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+			double weight = 0; // Total of the plane weights, error divides it back out
+
+			void add_plane(vec3 normal, float distance, double weight) {
+				this->weight += weight;
+				double a = normal.x, b = normal.y, c = normal.z, d = distance;
+				xx += weight * a * a; xy += weight * a * b; xz += weight * a * c; xw += weight * a * d;
+				yy += weight * b * b; yz += weight * b * c; yw += weight * b * d;
+				zz += weight * c * c; zw += weight * c * d;
+				ww += weight * d * d;
+			}
+			quadric operator+(const quadric& o) const {
+				return {xx + o.xx, xy + o.xy, xz + o.xz, xw + o.xw, yy + o.yy, yz + o.yz, yw + o.yw, zz + o.zz, zw + o.zw, ww + o.ww, weight + o.weight};
+			}
+			// Weighted mean squared distance, so the error stays in object space units² regardless of triangle areas
+			double error(vec3 p) const {
+				if(weight <= 0) return 0;
+				double x = p.x, y = p.y, z = p.z;
+				auto out = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+					+ yy * y * y + 2 * yz * y * z + 2 * yw * y
+					+ zz * z * z + 2 * zw * z
+					+ ww;
+				return std::max(out / weight, 0.0);
+			}
+		};
+
+		// Vertex -> triangle adjacency in compressed rows
+		struct triangle_adjacency {
+			std::vector<uint32_t> offsets, triangles;
+
+			triangle_adjacency(std::span<const uint32_t> indices, size_t vertex_count) : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+				for(auto index: indices) ++offsets[index + 1];
+				std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+				std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+				for(size_t i = 0; i < indices.size(); ++i)
+					triangles[cursor[indices[i]]++] = i / 3;
+			}
+
+			std::span<const uint32_t> operator[](uint32_t vertex) const {
+				return {triangles.data() + offsets[vertex], triangles.data() + offsets[vertex + 1]};
+			}
+		};
+	}
+
+	std::vector<uint32_t> mesh_optimizer::optimize_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, size_t cache_size /* = vertex_cache_size */) {
+		assert(indices.size() % 3 == 0);
+		std::vector<uint32_t> out; out.reserve(indices.size());
+		if(indices.empty()) return out;
+
+		triangle_adjacency adjacency(indices, vertex_count);
+		std::vector<uint32_t> live(vertex_count);
+		for(uint32_t v = 0; v < vertex_count; ++v) live[v] = adjacency[v].size();
+		std::vector<size_t> timestamps(vertex_count, 0);
+		std::vector<bool> emitted(indices.size() / 3, false);
+		std::vector<uint32_t> dead_ends, candidates;
+
+		size_t time = cache_size + 1, cursor = 0;
+		int64_t fanning = indices[0];
+		while(fanning >= 0) {
+			candidates.clear();
+			for(auto t: adjacency[fanning]) {
+				if(emitted[t]) continue;
+				for(size_t i = 0; i < 3; ++i) {
+					auto v = indices[t * 3 + i];
+					out.push_back(v);
+					dead_ends.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if(time - timestamps[v] > cache_size)
+						timestamps[v] = time++;
+				}
+				emitted[t] = true;
+			}
+
+			// Prefer the candidate which will still be in the cache after its remaining triangles are emitted
+			fanning = -1;
+			int64_t best_priority = -1;
+			for(auto v: candidates) {
+				if(live[v] == 0) continue;
+				int64_t priority = 0;
+				if(time - timestamps[v] + 2 * live[v] <= cache_size)
+					priority = time - timestamps[v];
+				if(priority > best_priority) {
+					best_priority = priority;
+					fanning = v;
+				}
+			}
+
+			// Dead end, fall back to recently used vertices and then to input order
+			while(fanning < 0 && !dead_ends.empty()) {
+				auto v = dead_ends.back(); dead_ends.pop_back();
+				if(live[v] > 0) fanning = v;
+			}
+			while(fanning < 0 && cursor < vertex_count) {
+				if(live[cursor] > 0) fanning = cursor;
+				++cursor;
+			}
+		}
+		return out;
+	}
+
+	std::vector<uint32_t> mesh_optimizer::optimize_vertex_fetch_remap(std::span<const uint32_t> indices, size_t vertex_count) {
+		std::vector<uint32_t> remap(vertex_count, unused_vertex);
+		uint32_t next = 0;
+		for(auto index: indices)
+			if(remap[index] == unused_vertex)
+				remap[index] = next++;
+		return remap;
+	}
+
+	float mesh_optimizer::average_cache_miss_ratio(std::span<const uint32_t> indices, size_t vertex_count, size_t cache_size /* = vertex_cache_size */) {
+		if(indices.empty()) return 0;
+		std::deque<uint32_t> cache;
+		std::vector<bool> cached(vertex_count, false);
+		size_t misses = 0;
+		for(auto index: indices) {
+			if(cached[index]) continue;
+			++misses;
+			cache.push_back(index);
+			cached[index] = true;
+			if(cache.size() > cache_size) {
+				cached[cache.front()] = false;
+				cache.pop_front();
+			}
+		}
+		return float(misses) / (indices.size() / 3);
+	}
+
+	std::vector<uint32_t> mesh_optimizer::simplify(mesh_view mesh, size_t target_index_count, float target_error /* = max */, float* result_error /* = nullptr */) {
+		assert(mesh.indices.size() % 3 == 0);
+		auto vertex_count = mesh.positions.size();
+		std::vector<vec3> positions(mesh.positions.begin(), mesh.positions.end());
+		std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+
+		// Every vertex starts with the (area weighted) planes of its triangles
+		std::vector<quadric> quadrics(vertex_count);
+		for(size_t i = 0; i < indices.size(); i += 3) {
+			auto& a = positions[indices[i]], & b = positions[indices[i + 1]], & c = positions[indices[i + 2]];
+			auto normal = cross(b - a, c - a);
+			auto area = length(normal);
+			if(area == 0) continue;
+			normal = normal * (1 / area);
+			for(size_t j = 0; j < 3; ++j)
+				quadrics[indices[i + j]].add_plane(normal, -dot(normal, a), area);
+		}
+
+		// Open boundaries (and attribute seams) have nothing holding them in place, so they aren't moved
+		std::vector<bool> locked(vertex_count, false);
+		{
+			std::unordered_map<uint64_t, uint32_t> edge_counts;
+			for(size_t i = 0; i < indices.size(); i += 3)
+				for(size_t j = 0; j < 3; ++j) {
+					uint64_t a = indices[i + j], b = indices[i + (j + 1) % 3];
+					++edge_counts[std::min(a, b) << 32 | std::max(a, b)];
+				}
+			for(auto [edge, count]: edge_counts)
+				if(count == 1) locked[edge >> 32] = locked[edge & 0xFFFFFFFF] = true;
+		}
+
+		struct collapse {
+			uint32_t from, to;
+			double cost;
+		};
+		auto flips = [&](const triangle_adjacency& adjacency, uint32_t from, uint32_t to) {
+			for(auto t: adjacency[from]) {
+				uint32_t v[3] = {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+				if(v[0] == to || v[1] == to || v[2] == to) continue; // Collapses away
+
+				auto before = cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+				for(auto& vertex: v) if(vertex == from) vertex = to;
+				auto after = cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+				if(dot(before, after) <= 1e-2f * length(before) * length(after))
+					return true;
+			}
+			return false;
+		};
+
+		double max_cost = 0, cost_limit = double(target_error) * target_error;
+		std::vector<uint32_t> remap(vertex_count);
+		std::iota(remap.begin(), remap.end(), 0);
+		std::vector<collapse> collapses;
+		std::vector<bool> touched(vertex_count);
+		while(indices.size() > target_index_count) {
+			triangle_adjacency adjacency(indices, vertex_count);
+
+			collapses.clear();
+			for(size_t i = 0; i < indices.size(); i += 3)
+				for(size_t j = 0; j < 3; ++j) {
+					auto a = indices[i + j], b = indices[i + (j + 1) % 3];
+					if(a > b) continue; // Each interior edge is seen from both sides
+					auto q = quadrics[a] + quadrics[b];
+					auto a_to_b = locked[a] ? std::numeric_limits<double>::max() : q.error(positions[b]);
+					auto b_to_a = locked[b] ? std::numeric_limits<double>::max() : q.error(positions[a]);
+					if(locked[a] && locked[b]) continue;
+					if(a_to_b <= b_to_a) collapses.push_back({a, b, a_to_b});
+					else collapses.push_back({b, a, b_to_a});
+				}
+			std::ranges::sort(collapses, {}, &collapse::cost);
+
+			// Each collapse removes about two triangles, take the cheapest independent ones
+			size_t budget = std::max<size_t>((indices.size() - target_index_count) / 6, 1), applied = 0;
+			std::fill(touched.begin(), touched.end(), false);
+			for(auto& c: collapses) {
+				if(applied >= budget || c.cost > cost_limit) break;
+				if(touched[c.from] || touched[c.to] || flips(adjacency, c.from, c.to)) continue;
+
+				remap[c.from] = c.to;
+				quadrics[c.to] = quadrics[c.to] + quadrics[c.from];
+				max_cost = std::max(max_cost, c.cost);
+				for(auto t: adjacency[c.from])
+					for(size_t j = 0; j < 3; ++j)
+						touched[indices[t * 3 + j]] = true;
+				++applied;
+			}
+			if(applied == 0) break;
+
+			size_t write = 0;
+			for(size_t i = 0; i < indices.size(); i += 3) {
+				auto a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+				if(a == b || b == c || a == c) continue;
+				indices[write++] = a; indices[write++] = b; indices[write++] = c;
+			}
+			indices.resize(write);
+		}
+
+		if(result_error) *result_error = std::sqrt(max_cost);
+		return indices;
+	}
+
+	bool meshlet_bounds::backfacing(float3 camera_position) const {
+		vec3 view = vec3(cone_apex) - vec3(camera_position);
+		return dot(normalize(view), cone_axis) >= cone_cutoff;
+	}
+
+	meshlet_set meshlet_set::build(mesh_view mesh, size_t max_vertices /* = default_max_vertices */, size_t max_triangles /* = default_max_triangles */) {
+		assert(max_vertices >= 3 && max_vertices <= 256 && max_triangles > 0);
+		meshlet_set out;
+		std::vector<int16_t> local(mesh.positions.size(), -1); // Vertex -> index in the current meshlet
+
+		auto finish = [&](meshlet& m) {
+			if(m.triangle_count == 0) return;
+			for(size_t i = 0; i < m.vertex_count; ++i)
+				local[out.vertices[m.vertex_offset + i]] = -1;
+
+			vec3 low = mesh.positions[out.vertices[m.vertex_offset]], high = low;
+			for(size_t i = 0; i < m.vertex_count; ++i) {
+				vec3 p = mesh.positions[out.vertices[m.vertex_offset + i]];
+				low = {std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z)};
+				high = {std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z)};
+			}
+			vec3 center = (low + high) * .5f;
+			float radius = 0;
+			for(size_t i = 0; i < m.vertex_count; ++i)
+				radius = std::max(radius, length(vec3(mesh.positions[out.vertices[m.vertex_offset + i]]) - center));
+
+			// The cone contains every triangle normal, its apex is placed so the test is exact for any camera position
+			std::vector<std::pair<vec3, vec3>> triangles; // Normal, first corner
+			vec3 axis;
+			for(size_t t = 0; t < m.triangle_count; ++t) {
+				auto corner = [&](size_t i) { return vec3(mesh.positions[out.vertices[m.vertex_offset + out.triangles[(m.triangle_offset + t) * 3 + i]]]); };
+				auto normal = normalize(cross(corner(1) - corner(0), corner(2) - corner(0)));
+				triangles.emplace_back(normal, corner(0));
+				axis = axis + normal;
+			}
+			axis = normalize(axis);
+
+			float min_dot = 1;
+			for(auto& [normal, corner]: triangles) min_dot = std::min(min_dot, dot(normal, axis));
+			meshlet_bounds bounds = {.center = center, .radius = radius, .cone_apex = center, .cone_axis = axis, .cone_cutoff = 1};
+			if(min_dot > .1f) {
+				float max_t = 0;
+				for(auto& [normal, corner]: triangles)
+					max_t = std::max(max_t, dot(center - corner, normal) / dot(axis, normal));
+				bounds.cone_apex = center - axis * max_t;
+				bounds.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+			}
+			out.bounds.push_back(bounds);
+			out.meshlets.push_back(m);
+		};
+
+		meshlet current = {};
+		for(size_t i = 0; i < mesh.indices.size(); i += 3) {
+			size_t new_vertices = 0;
+			for(size_t j = 0; j < 3; ++j)
+				new_vertices += local[mesh.indices[i + j]] < 0;
+			if(current.vertex_count + new_vertices > max_vertices || current.triangle_count + 1 > max_triangles) {
+				finish(current);
+				current = {.vertex_offset = (uint32_t)out.vertices.size(), .triangle_offset = uint32_t(out.triangles.size() / 3), .vertex_count = 0, .triangle_count = 0};
+			}
+
+			for(size_t j = 0; j < 3; ++j) {
+				auto& l = local[mesh.indices[i + j]];
+				if(l < 0) {
+					l = current.vertex_count++;
+					out.vertices.push_back(mesh.indices[i + j]);
+				}
+				out.triangles.push_back(l);
+			}
+			++current.triangle_count;
+		}
+		finish(current);
+		return out;
+	}
+
+	size_t processed_mesh::select_lod(float3 position, float scale, float3 camera_position, float vertical_fov, float viewport_height, float pixel_threshold /* = 1 */) const {
+		auto distance = length(vec3(position) + vec3(center) * scale - vec3(camera_position)) - radius * scale;
+		return select_lod(distance, vertical_fov, viewport_height, scale, pixel_threshold);
+	}
+
+	namespace {
+		template<typename T>
+		void write_vector(std::ostream& file, const std::vector<T>& data) {
+			uint64_t size = data.size();
+			file.write((const char*)&size, sizeof(size));
+			file.write((const char*)data.data(), size * sizeof(T));
+		}
+		template<typename T>
+		bool read_vector(std::istream& file, std::vector<T>& data) {
+			uint64_t size;
+			if(!file.read((char*)&size, sizeof(size))) return false;
+			data.resize(size);
+			return (bool)file.read((char*)data.data(), size * sizeof(T));
+		}
+		std::vector<float> flatten(std::span<const float3> points) {
+			std::vector<float> out; out.reserve(points.size() * 3);
+			for(vec3 p: points) out.insert(out.end(), {p.x, p.y, p.z});
+			return out;
+		}
+		std::vector<float3> unflatten(std::span<const float> floats) {
+			std::vector<float3> out; out.reserve(floats.size() / 3);
+			for(size_t i = 0; i + 2 < floats.size(); i += 3) out.emplace_back(floats[i], floats[i + 1], floats[i + 2]);
+			return out;
+		}
+
+		struct mesh_cache {
+			std::mutex mutex;
+			std::unordered_map<uint64_t, std::shared_ptr<const processed_mesh>> entries;
+			std::filesystem::path directory;
+
+			static mesh_cache& get() {
+				static mesh_cache cache;
+				return cache;
+			}
+
+			std::filesystem::path path(uint64_t hash) {
+				char name[32];
+				std::snprintf(name, sizeof(name), "%016llx.stylizer-mesh", (unsigned long long)hash);
+				return directory / name;
+			}
+
+			std::shared_ptr<const processed_mesh> load(uint64_t hash) {
+				if(directory.empty()) return nullptr;
+				std::ifstream file(path(hash), std::ios::binary);
+				if(!file) return nullptr;
+
+				auto out = std::make_shared<processed_mesh>();
+				std::vector<float> floats;
+				uint64_t lod_count;
+				if(!read_vector(file, floats)) return nullptr;
+				out->positions = unflatten(floats);
+				if(!read_vector(file, out->remap) || !read_vector(file, floats) || floats.size() != 4) return nullptr;
+				out->center = float3(floats[0], floats[1], floats[2]);
+				out->radius = floats[3];
+
+				if(!file.read((char*)&lod_count, sizeof(lod_count))) return nullptr;
+				out->lods.resize(lod_count);
+				for(auto& lod: out->lods) {
+					if(!read_vector(file, lod.indices) || !file.read((char*)&lod.error, sizeof(lod.error))) return nullptr;
+					if(!read_vector(file, lod.meshlets.meshlets) || !read_vector(file, lod.meshlets.vertices) || !read_vector(file, lod.meshlets.triangles) || !read_vector(file, floats))
+						return nullptr;
+					for(size_t i = 0; i + 10 < floats.size(); i += 11)
+						lod.meshlets.bounds.push_back({
+							.center = float3(floats[i], floats[i + 1], floats[i + 2]), .radius = floats[i + 3],
+							.cone_apex = float3(floats[i + 4], floats[i + 5], floats[i + 6]),
+							.cone_axis = float3(floats[i + 7], floats[i + 8], floats[i + 9]), .cone_cutoff = floats[i + 10]
+						});
+				}
+				return out;
+			}
+
+			void save(uint64_t hash, const processed_mesh& mesh) {
+				if(directory.empty()) return;
+				std::filesystem::create_directories(directory);
+				std::ofstream file(path(hash), std::ios::binary);
+
+				vec3 center = mesh.center;
+				write_vector(file, flatten(mesh.positions));
+				write_vector(file, mesh.remap);
+				write_vector(file, std::vector<float>{center.x, center.y, center.z, mesh.radius});
+				uint64_t lod_count = mesh.lods.size();
+				file.write((const char*)&lod_count, sizeof(lod_count));
+				for(auto& lod: mesh.lods) {
+					write_vector(file, lod.indices);
+					file.write((const char*)&lod.error, sizeof(lod.error));
+					write_vector(file, lod.meshlets.meshlets);
+					write_vector(file, lod.meshlets.vertices);
+					write_vector(file, lod.meshlets.triangles);
+					std::vector<float> bounds;
+					for(auto& b: lod.meshlets.bounds) {
+						vec3 c = b.center, apex = b.cone_apex, axis = b.cone_axis;
+						bounds.insert(bounds.end(), {c.x, c.y, c.z, b.radius, apex.x, apex.y, apex.z, axis.x, axis.y, axis.z, b.cone_cutoff});
+					}
+					write_vector(file, bounds);
+				}
+			}
+		};
+
+		uint64_t hash_mesh(mesh_view mesh, const processed_mesh::create_config& config) {
+			constexpr uint32_t version = 2; // Bumped whenever simplification results change, so stale disk entries are ignored
+			auto hash = hash_value(version);
+			hash = hash_value(config.max_levels, hash);
+			hash = hash_value(config.reduction, hash);
+			hash = hash_value(config.max_error, hash);
+			hash = hash_value(config.build_meshlets, hash);
+			hash = hash_value(config.meshlet_max_vertices, hash);
+			hash = hash_value(config.meshlet_max_triangles, hash);
+			for(vec3 p: mesh.positions) { // float3 may be padded, only hash the components
+				hash = hash_value(p.x, hash);
+				hash = hash_value(p.y, hash);
+				hash = hash_value(p.z, hash);
+			}
+			return hash_bytes(std::as_bytes(mesh.indices), hash);
+		}
+
+		std::shared_ptr<const processed_mesh> process_uncached(mesh_view mesh, const processed_mesh::create_config& config, bool parallel) {
+			auto out = std::make_shared<processed_mesh>();
+			auto vertex_count = mesh.positions.size();
+
+			auto indices = mesh_optimizer::optimize_vertex_cache(mesh.indices, vertex_count);
+			out->remap = mesh_optimizer::optimize_vertex_fetch_remap(indices, vertex_count);
+			mesh_optimizer::apply_remap(indices, out->remap);
+			out->positions = mesh_optimizer::remap_vertices(mesh.positions, out->remap);
+			if(out->positions.empty()) return out;
+
+			vec3 low = out->positions[0], high = low;
+			for(vec3 p: out->positions) {
+				low = {std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z)};
+				high = {std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z)};
+			}
+			vec3 center = (low + high) * .5f;
+			out->center = center;
+			for(vec3 p: out->positions) out->radius = std::max(out->radius, length(p - center));
+
+			// Every level is simplified from full detail so they can be built independently
+			out->lods.resize(std::max<size_t>(config.max_levels, 1));
+			out->lods[0].indices = std::move(indices);
+			mesh_view full = {out->positions, out->lods[0].indices};
+			auto build_level = [&, full](size_t level) {
+				auto& lod = out->lods[level];
+				if(level > 0) {
+					auto target = size_t(full.indices.size() / 3 * std::pow(config.reduction, level)) * 3;
+					lod.indices = mesh_optimizer::simplify(full, target, config.max_error * out->radius, &lod.error);
+					lod.indices = mesh_optimizer::optimize_vertex_cache(lod.indices, out->positions.size());
+				}
+				if(config.build_meshlets)
+					lod.meshlets = meshlet_set::build({out->positions, lod.indices}, config.meshlet_max_vertices, config.meshlet_max_triangles);
+			};
+
+			if(parallel) {
+				std::vector<std::future<void>> tasks;
+				for(size_t level = 1; level < out->lods.size(); ++level)
+					tasks.emplace_back(thread_pool::enqueue([&build_level, level] { build_level(level); }));
+				build_level(0);
+				for(auto& task: tasks) task.get();
+			} else for(size_t level = 0; level < out->lods.size(); ++level)
+				build_level(level);
+
+			// Drop levels which hit the error limit without getting meaningfully smaller
+			size_t keep = 1;
+			for(; keep < out->lods.size(); ++keep) {
+				auto& previous = out->lods[keep - 1];
+				if(out->lods[keep].indices.size() > previous.indices.size() * 9 / 10) break;
+				out->lods[keep].error = std::max(out->lods[keep].error, previous.error);
+			}
+			out->lods.resize(keep);
+			return out;
+		}
+
+		std::shared_ptr<const processed_mesh> process_cached(mesh_view mesh, const processed_mesh::create_config& config, bool parallel) {
+			auto& cache = mesh_cache::get();
+			auto hash = hash_mesh(mesh, config);
+			{
+				std::scoped_lock lock(cache.mutex);
+				if(auto found = cache.entries.find(hash); found != cache.entries.end())
+					return found->second;
+				if(auto loaded = cache.load(hash))
+					return cache.entries[hash] = loaded;
+			}
+
+			auto out = process_uncached(mesh, config, parallel);
+			std::scoped_lock lock(cache.mutex);
+			cache.save(hash, *out);
+			return cache.entries[hash] = out;
+		}
+	}
+
+	std::shared_ptr<const processed_mesh> processed_mesh::process(mesh_view mesh, create_config config /* = {} */) {
+		return process_cached(mesh, config, true);
+	}
+
+	std::vector<std::shared_ptr<const processed_mesh>> processed_mesh::process_all(std::span<const mesh_view> meshes, create_config config /* = {} */) {
+		std::vector<std::future<std::shared_ptr<const processed_mesh>>> tasks;
+		for(auto& mesh: meshes)
+			tasks.emplace_back(thread_pool::enqueue([mesh, &config] { return process_cached(mesh, config, false); }));
+
+		std::vector<std::shared_ptr<const processed_mesh>> out;
+		for(auto& task: tasks) out.emplace_back(task.get());
+		return out;
+	}
+
+	void processed_mesh::set_cache_directory(std::filesystem::path directory) {
+		auto& cache = mesh_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		cache.directory = std::move(directory);
+	}
+
+	void processed_mesh::clear_cache() {
+		auto& cache = mesh_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		cache.entries.clear();
+	}
+
+} // namespace stylizer
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <limits>
+
+namespace stylizer {
+
+//////////////////////////////////////////////////////////////////////
+// # Mesh Optimization
+//////////////////////////////////////////////////////////////////////
+
+
+	// Indexed triangle list
+	struct mesh_view {
+		std::span<const float3> positions;
+		std::span<const uint32_t> indices;
+	};
+
+	struct mesh_optimizer {
+		static constexpr size_t vertex_cache_size = 16;
+		static constexpr uint32_t unused_vertex = ~0u;
+
+		// Reorders triangles so recently transformed vertices are reused (Tipsify)
+		static std::vector<uint32_t> optimize_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, size_t cache_size = vertex_cache_size);
+		// Returns an old -> new vertex remap which orders vertices by first use, unreferenced vertices map to unused_vertex
+		static std::vector<uint32_t> optimize_vertex_fetch_remap(std::span<const uint32_t> indices, size_t vertex_count);
+		static void apply_remap(std::span<uint32_t> indices, std::span<const uint32_t> remap) {
+			for(auto& index: indices) index = remap[index];
+		}
+		template<typename T>
+		static std::vector<T> remap_vertices(std::span<const T> vertices, std::span<const uint32_t> remap) {
+			std::vector<T> out(std::ranges::count_if(remap, [](uint32_t i) { return i != unused_vertex; }));
+			for(size_t i = 0; i < vertices.size(); ++i)
+				if(remap[i] != unused_vertex)
+					out[remap[i]] = vertices[i];
+			return out;
+		}
+
+		// Average cache miss ratio (transformed vertices per triangle) of a FIFO cache, 0.5 is ideal and 3 is worst
+		static float average_cache_miss_ratio(std::span<const uint32_t> indices, size_t vertex_count, size_t cache_size = vertex_cache_size);
+
+		// Quadric error edge collapse, vertices are kept in place so every level can share the same vertex buffer
+		// NOTE: Stops early once collapses would move the surface further than target_error (in object space)
+		static std::vector<uint32_t> simplify(mesh_view mesh, size_t target_index_count, float target_error = std::numeric_limits<float>::max(), float* result_error = nullptr);
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Meshlets
+//////////////////////////////////////////////////////////////////////
+
+
+	struct meshlet {
+		uint32_t vertex_offset, triangle_offset; // Into meshlet_set::vertices and meshlet_set::triangles (in triangles)
+		uint32_t vertex_count, triangle_count;
+	};
+
+	struct meshlet_bounds {
+		float3 center;
+		float radius;
+		float3 cone_apex;
+		float3 cone_axis;
+		float cone_cutoff; // Cosine of the cone's half angle, 1 when the meshlet can never be backface culled
+
+		// True when every triangle of the meshlet faces away from the camera
+		bool backfacing(float3 camera_position) const;
+	};
+
+	struct meshlet_set {
+		std::vector<meshlet> meshlets;
+		std::vector<uint32_t> vertices; // Indices into the mesh's vertex buffer
+		std::vector<uint8_t> triangles; // Three indices into the meshlet's vertices per triangle
+		std::vector<meshlet_bounds> bounds;
+
+		static constexpr size_t default_max_vertices = 64, default_max_triangles = 124;
+		static meshlet_set build(mesh_view mesh, size_t max_vertices = default_max_vertices, size_t max_triangles = default_max_triangles);
+	};
+
+
+//////////////////////////////////////////////////////////////////////
+// # Mesh LOD
+//////////////////////////////////////////////////////////////////////
+
+
+	struct mesh_lod_create_config {
+		size_t max_levels = 6;
+		float reduction = .5; // Fraction of the previous level's triangles to aim for
+		float max_error = .05; // Relative to the mesh's bounding radius, levels stop once it is reached
+		bool build_meshlets = true;
+		size_t meshlet_max_vertices = meshlet_set::default_max_vertices;
+		size_t meshlet_max_triangles = meshlet_set::default_max_triangles;
+	};
+
+	struct mesh_lod {
+		std::vector<uint32_t> indices;
+		float error = 0; // Object space distance from the full detail surface
+		meshlet_set meshlets;
+	};
+
+	struct processed_mesh {
+		using create_config = mesh_lod_create_config;
+
+		std::vector<float3> positions; // Reordered for fetch locality, shared by every level
+		std::vector<uint32_t> remap; // Original -> new vertex index, use with mesh_optimizer::remap_vertices for other attributes
+		std::vector<mesh_lod> lods; // Level 0 is full detail
+		float3 center;
+		float radius = 0;
+
+		// Levels are simplified in parallel on the thread_pool, results are cached by content hash
+		// NOTE: Blocks until processing is finished, don't call from a thread_pool task
+		static std::shared_ptr<const processed_mesh> process(mesh_view mesh, create_config config = {});
+		// Processes each mesh as its own thread_pool task
+		static std::vector<std::shared_ptr<const processed_mesh>> process_all(std::span<const mesh_view> meshes, create_config config = {});
+
+		// Processed meshes are kept in memory and, if a directory is set, on disk between runs
+		static void set_cache_directory(std::filesystem::path directory);
+		static void clear_cache();
+
+		// Size in pixels of something world_size across at distance from a perspective camera
+		static float projected_size(float world_size, float distance, float vertical_fov, float viewport_height) {
+			return world_size / std::max(distance, 1e-4f) * viewport_height / (2 * std::tan(vertical_fov / 2));
+		}
+
+		// Picks the coarsest level whose error projects to no more than pixel_threshold pixels
+		size_t select_lod(float distance, float vertical_fov, float viewport_height, float scale = 1, float pixel_threshold = 1) const {
+			size_t out = 0;
+			for(size_t i = 1; i < lods.size(); ++i)
+				if(projected_size(lods[i].error * scale, distance, vertical_fov, viewport_height) <= pixel_threshold)
+					out = i;
+				else break;
+			return out;
+		}
+		size_t select_lod(float3 position, float scale, float3 camera_position, float vertical_fov, float viewport_height, float pixel_threshold = 1) const;
+	};
+
+} // namespace stylizer
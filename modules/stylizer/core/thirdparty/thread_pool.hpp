@@ -100,10 +100,34 @@ class ThreadPool
 #endif
     }
 
+    // Modification: Intrusive tasks carry their own link, so adding one never allocates
+    struct IntrusiveTask
+    {
+        void (*run)(IntrusiveTask* self) = nullptr;
+        IntrusiveTask* next = nullptr;
+    };
+
+    // The task must stay alive until run is called, run is responsible for destroying it
+    void AddIntrusiveTask(IntrusiveTask* task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task->next = nullptr;
+        if (intrusive_tail)
+            intrusive_tail->next = task;
+        else
+            intrusive_head = task;
+        intrusive_tail = task;
+        // Wake up one thread if its waiting
+        condition_variable.notify_one();
+    }
+
     int QueueSize()
     {
         std::unique_lock<std::mutex> lock(mutex);
-        return queue.size();
+        int size = queue.size();
+        for (auto task = intrusive_head; task; task = task->next) // Modification
+            ++size;
+        return size;
     }
 
   private:
@@ -117,11 +141,11 @@ class ThreadPool
         void operator()()
         {
             std::unique_lock<std::mutex> lock(thread_pool->mutex);
-            while (!thread_pool->shutdown_requested || (thread_pool->shutdown_requested && !thread_pool->queue.empty()))
+            while (!thread_pool->shutdown_requested || (thread_pool->shutdown_requested && thread_pool->HasWork()))
             {
                 thread_pool->busy_threads--;
                 thread_pool->condition_variable.wait(lock, [this] {
-                    return this->thread_pool->shutdown_requested || !this->thread_pool->queue.empty();
+                    return this->thread_pool->shutdown_requested || this->thread_pool->HasWork();
                 });
                 thread_pool->busy_threads++;
 
@@ -138,6 +162,16 @@ class ThreadPool
                     func();
                     lock.lock();
                 }
+                else if (auto task = thread_pool->intrusive_head) // Modification
+                {
+                    thread_pool->intrusive_head = task->next;
+                    if (!thread_pool->intrusive_head)
+                        thread_pool->intrusive_tail = nullptr;
+
+                    lock.unlock();
+                    task->run(task);
+                    lock.lock();
+                }
             }
         }
 
@@ -149,6 +183,12 @@ class ThreadPool
     int busy_threads;
 
   private:
+    // Modification: Must be called with the mutex held
+    bool HasWork() const
+    {
+        return !queue.empty() || intrusive_head;
+    }
+
     mutable std::mutex mutex;
     std::condition_variable condition_variable;
 
@@ -160,5 +200,7 @@ class ThreadPool
 #else
     std::queue<std::function<void()>> queue;
 #endif
+    IntrusiveTask* intrusive_head = nullptr; // Modification
+    IntrusiveTask* intrusive_tail = nullptr; // Modification
 };
 } // Modification
\ No newline at end of file
@@ -85,9 +85,13 @@ namespace stylizer {
 #ifndef STYLIZER_USE_ABSTRACT_API
 	context window::create_context(const api::device::create_config& config /* = {} */) {
 		auto partial = context::create_default(config);
-		partial.surface = api::glfw::create_surface<api::current_backend::surface>(window_);
+		partial.surface = create_surface();
 		return partial;
 	}
+
+	api::current_backend::surface window::create_surface() const {
+		return api::glfw::create_surface<api::current_backend::surface>(window_);
+	}
 #endif
 
 } // namespace stylizer
\ No newline at end of file
@@ -56,16 +56,34 @@ namespace stylizer {
 
 		bool should_close(bool process_events = true) const;
 
-		inline bool should_close(context& ctx) const { // Override which automatically processes context events as well
+		inline bool should_close(context& ctx) const { // Override which automatically processes context events (and advances the frame) as well
+			ctx.next_frame();
 			ctx.process_events();
 			return should_close(true);
 		}
+		// Multi-window loops call this once per frame instead, calling should_close(ctx) on every window would advance the frame once per window
+		static bool any_should_close(context& ctx, std::initializer_list<std::reference_wrapper<const window>> windows) {
+			ctx.next_frame();
+			ctx.process_events();
+			bool out = false, poll = true; // Polling is global, once covers every window
+			for(const window& window: windows)
+				out |= window.should_close(std::exchange(poll, false));
+			return out;
+		}
 
 		uint2 get_dimensions() const;
 		inline uint2 get_size() const { return get_dimensions(); }
 
 #ifndef STYLIZER_USE_ABSTRACT_API
 		context create_context(const api::device::create_config& config = {});
+		// Surfaces aren't tied to a device, one created here can be configured with any context's device
+		api::current_backend::surface create_surface() const;
+		// Lets several windows share one context (and device), the surface comes back configured to the window's size
+		viewport create_viewport(context& ctx, geometry_buffer::create_config config = {}) const {
+			auto out = viewport::create_default(ctx, create_surface(), get_size(), config);
+			configure_surface(ctx, determine_optimal_config(ctx, out.surface), out.surface);
+			return out;
+		}
 #endif
 
 		api::surface::config determine_optimal_config(context& ctx, stylizer::api::surface& surface) const {
@@ -101,6 +119,12 @@ namespace stylizer {
 			});
 			return *this;
 		}
+
+		// NOTE: The viewport must not move after this is called
+		window& auto_resize_viewport(context& ctx, viewport& viewport) {
+			reconfigure_surface_on_resize(ctx, determine_optimal_config(ctx, viewport.surface), viewport.surface);
+			return auto_resize_geometry_buffer(ctx, viewport.gbuffer);
+		}
 	};
 
 	template<>
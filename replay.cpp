@@ -0,0 +1,295 @@
+#include "stylizer/core/core.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+using opcode = stylizer::command_recorder::opcode;
+using clock_type = std::chrono::steady_clock;
+
+// Re-executes a trace captured with stylizer::command_recorder against an offscreen device
+struct replayer {
+	stylizer::context& ctx;
+	std::unordered_map<uint32_t, stylizer::geometry_buffer> gbuffers;
+	std::unordered_map<uint32_t, stylizer::material> materials;
+	std::unordered_map<uint32_t, stylizer::tracked<STYLIZER_API_TYPE(buffer)>> buffers;
+	std::unordered_map<uint32_t, stylizer::tracked<stylizer::texture>> textures;
+	std::unordered_map<uint32_t, stylizer::material_bind_group> bind_groups;
+	std::unordered_map<uint32_t, stylizer::tracked<stylizer::texture>> surfaces; // Offscreen stand-ins for the recorded surfaces
+	std::optional<stylizer::drawing_state> pass;
+	stylizer::dynamic_resolution upscaler = {}; // Only its upscale pass is used
+	std::vector<STYLIZER_API_TYPE(command_buffer)> pending;
+	std::vector<clock_type::duration> frame_times;
+
+	stylizer::texture& surface(uint32_t id, uint32_t width, uint32_t height, stylizer::texture::format format) {
+		using namespace stylizer::api::operators;
+
+		auto& out = surfaces[id];
+		auto size = out ? out.get_size() : stylizer::api::vec3u{};
+		if(out && size.x == width && size.y == height && out.get_format() == format) return out;
+
+		if(out) out.release();
+		return out = ctx.create_texture({
+			.label = "Stylizer Replay Surface Texture",
+			.format = format,
+			.usage = stylizer::api::usage::RenderAttachment | stylizer::api::usage::TextureBinding | stylizer::api::usage::CopyDestination,
+			.size = stylizer::api::convert(stylizer::uint3(width, height, 1))
+		}, "replay");
+	}
+
+	template<typename T>
+	static T& lookup(std::unordered_map<uint32_t, T>& map, uint32_t id, std::string_view what) {
+		auto found = map.find(id);
+		if(found == map.end()) throw std::runtime_error("Trace references a " + std::string{what} + " which wasn't recorded");
+		return found->second;
+	}
+	// Commands which need a pass throw when the trace didn't record one beginning
+	stylizer::drawing_state& active_pass() {
+		if(!pass) throw std::runtime_error("Unbalanced command stream: pass command outside of a pass");
+		return *pass;
+	}
+
+	void run(stylizer::command_stream_reader reader) {
+		auto frame_start = clock_type::now();
+		while(!reader.done()) {
+			switch(reader.read_opcode()) {
+				case opcode::CreateGeometryBuffer: {
+					auto id = reader.read<uint32_t>();
+					auto width = reader.read<uint32_t>(), height = reader.read<uint32_t>();
+					auto color = (stylizer::texture::format)reader.read<uint32_t>(), depth = (stylizer::texture::format)reader.read<uint32_t>();
+					if(auto& old = gbuffers[id]; old) old.release();
+					gbuffers[id] = stylizer::geometry_buffer::create_default(ctx, {width, height}, {.color_format = color, .depth_format = depth});
+				}
+				break;
+				case opcode::CreateMaterial: {
+					auto id = reader.read<uint32_t>(), gbuffer = reader.read<uint32_t>();
+					auto module = reader.read_string(), source = reader.read_string();
+					stylizer::shader_processor::entry_points entry_points;
+					for(auto i = reader.read<uint32_t>(); i--; ) {
+						auto stage = (stylizer::api::shader::stage)reader.read<uint32_t>();
+						entry_points[stage] = reader.read_string();
+					}
+					stylizer::api::render_pipeline::config config = {};
+					reader.read_value(config);
+					if(auto& old = materials[id]; old) old.release();
+					materials[id] = stylizer::material::create_from_source_for_geometry_buffer(ctx, source, entry_points, lookup(gbuffers, gbuffer, "geometry buffer"), module, config);
+				}
+				break;
+				case opcode::CreateBuffer: {
+					auto id = reader.read<uint32_t>();
+					STYLIZER_API_TYPE(buffer)::create_config config = {};
+					reader.read_value(config);
+					if(auto& old = buffers[id]; old) old.release();
+					buffers[id] = ctx.create_buffer(config, "replay");
+				}
+				break;
+				case opcode::CreateTexture: {
+					auto id = reader.read<uint32_t>();
+					stylizer::texture::create_config config = {};
+					reader.read_value(config);
+					if(auto& old = textures[id]; old) old.release();
+					textures[id] = ctx.create_texture(config, "replay");
+				}
+				break;
+				case opcode::WriteBuffer: {
+					auto& buffer = lookup(buffers, reader.read<uint32_t>(), "buffer");
+					auto offset = reader.read<uint64_t>();
+					buffer.write(ctx, reader.read_bytes(), offset);
+				}
+				break;
+				case opcode::WriteTexture: {
+					auto& texture = lookup(textures, reader.read<uint32_t>(), "texture");
+					auto bytes_per_row = reader.read<uint64_t>();
+					stylizer::api::vec3u extent;
+					extent.x = reader.read<uint32_t>(); extent.y = reader.read<uint32_t>(); extent.z = reader.read<uint32_t>();
+					auto mip = reader.read<uint32_t>();
+					texture.write(ctx, reader.read_bytes(), bytes_per_row, extent, mip);
+				}
+				break;
+				case opcode::CreateBindGroup: {
+					auto id = reader.read<uint32_t>();
+					auto& material = lookup(materials, reader.read<uint32_t>(), "material");
+					auto index = reader.read<uint32_t>();
+					std::vector<stylizer::material_binding> bindings(reader.read<uint32_t>());
+					for(auto& binding: bindings) {
+						auto kind = reader.read<uint8_t>();
+						auto resource = reader.read<uint32_t>();
+						if(kind == 0) binding.resource = &lookup(buffers, resource, "buffer");
+						else binding.resource = &lookup(textures, resource, "texture");
+						binding.offset = reader.read<uint64_t>();
+						reader.read_value(binding.size);
+						reader.read_value(binding.sampled);
+					}
+					if(auto& old = bind_groups[id]; old) old.release();
+					bind_groups[id] = material.create_bind_group(ctx, index, bindings);
+				}
+				break;
+				case opcode::BeginPass: {
+					auto gbuffer = reader.read<uint32_t>(), surface_id = reader.read<uint32_t>();
+					auto width = reader.read<uint32_t>(), height = reader.read<uint32_t>();
+					auto format = (stylizer::texture::format)reader.read<uint32_t>();
+					stylizer::float4 clear_color;
+					clear_color.x = reader.read<float>(); clear_color.y = reader.read<float>();
+					clear_color.z = reader.read<float>(); clear_color.w = reader.read<float>();
+					auto clear_depth = reader.read<float>();
+					bool one_shot = reader.read<uint8_t>();
+
+					if(pass) throw std::runtime_error("Unbalanced command stream: pass begun inside another pass");
+					if(!gbuffer && !surface_id) throw std::runtime_error("Command stream begins a pass without a target");
+					// Recorded textures are drawn into directly so later passes can sample the result, anything else gets a stand-in
+					stylizer::texture* target = nullptr;
+					if(auto found = textures.find(surface_id); found != textures.end()) target = &found->second;
+					else if(surface_id) target = &surface(surface_id, width, height, format);
+					if(gbuffer) pass = lookup(gbuffers, gbuffer, "geometry buffer").begin_drawing_into(ctx, target, clear_color, clear_depth, one_shot);
+					else pass = target->begin_drawing(ctx, clear_color, one_shot);
+				}
+				break;
+				case opcode::BindMaterial:
+					active_pass().bind_material(ctx, lookup(materials, reader.read<uint32_t>(), "material"));
+				break;
+				case opcode::BindGroup:
+					active_pass().bind_group(ctx, lookup(bind_groups, reader.read<uint32_t>(), "bind group"));
+				break;
+				case opcode::BindVertexBuffer: {
+					auto slot = reader.read<uint32_t>();
+					auto& buffer = lookup(buffers, reader.read<uint32_t>(), "buffer");
+					active_pass().bind_vertex_buffer(ctx, slot, buffer, reader.read<uint64_t>());
+				}
+				break;
+				case opcode::BindIndexBuffer: {
+					auto& buffer = lookup(buffers, reader.read<uint32_t>(), "buffer");
+					active_pass().bind_index_buffer(ctx, buffer, reader.read<uint64_t>());
+				}
+				break;
+				case opcode::BindUnrecordedPipeline:
+					throw std::runtime_error("Trace binds a pipeline which wasn't created through a material, it can't be replayed");
+				case opcode::SetViewport: {
+					stylizer::uint2 origin, size;
+					origin.x = reader.read<uint32_t>(); origin.y = reader.read<uint32_t>();
+					size.x = reader.read<uint32_t>(); size.y = reader.read<uint32_t>();
+					auto min_depth = reader.read<float>(), max_depth = reader.read<float>();
+					active_pass().set_viewport(ctx, origin, size, min_depth, max_depth);
+				}
+				break;
+				case opcode::Draw: {
+					auto vertex_count = reader.read<uint32_t>(), instance_count = reader.read<uint32_t>();
+					auto first_vertex = reader.read<uint32_t>(), first_instance = reader.read<uint32_t>();
+					active_pass().draw(ctx, vertex_count, instance_count, first_vertex, first_instance);
+				}
+				break;
+				case opcode::DrawIndexed: {
+					auto index_count = reader.read<uint32_t>(), instance_count = reader.read<uint32_t>();
+					auto first_index = reader.read<uint32_t>(), base_vertex = reader.read<uint32_t>(), first_instance = reader.read<uint32_t>();
+					active_pass().draw_indexed(ctx, index_count, instance_count, first_index, base_vertex, first_instance);
+				}
+				break;
+				case opcode::EndPass:
+					pending.emplace_back(active_pass().end());
+					pass.reset();
+				break;
+				case opcode::OneShotSubmit:
+					active_pass().one_shot_submit();
+					pass.reset();
+				break;
+				case opcode::Submit:
+					ctx.device.submit(pending);
+					pending.clear();
+				break;
+				case opcode::Blit: {
+					auto gbuffer = reader.read<uint32_t>(), surface_id = reader.read<uint32_t>();
+					auto width = reader.read<uint32_t>(), height = reader.read<uint32_t>();
+					auto format = (stylizer::texture::format)reader.read<uint32_t>();
+					surface(surface_id, width, height, format).blit_from(ctx, lookup(gbuffers, gbuffer, "geometry buffer").color);
+				}
+				break;
+				case opcode::Upscale: {
+					auto gbuffer = reader.read<uint32_t>(), surface_id = reader.read<uint32_t>();
+					auto width = reader.read<uint32_t>(), height = reader.read<uint32_t>();
+					auto format = (stylizer::texture::format)reader.read<uint32_t>();
+					stylizer::uint2 source;
+					source.x = reader.read<uint32_t>(); source.y = reader.read<uint32_t>();
+					if(!upscaler.uniforms) upscaler = stylizer::dynamic_resolution::create(ctx);
+					upscaler.upscale(ctx, surface(surface_id, width, height, format), lookup(gbuffers, gbuffer, "geometry buffer"), source);
+				}
+				break;
+				case opcode::Present:
+					reader.read<uint32_t>(); // Nothing to present offscreen
+				break;
+				case opcode::ProcessEvents:
+					ctx.process_events();
+				break;
+				case opcode::EndFrame: {
+					ctx.next_frame();
+					auto now = clock_type::now();
+					frame_times.push_back(now - frame_start);
+					frame_start = now;
+				}
+				break;
+				default:
+					throw std::runtime_error("Unknown opcode in command stream");
+			}
+		}
+		if(pass) throw std::runtime_error("Unbalanced command stream: ends inside a pass");
+	}
+
+	void release() {
+		if(pass) pass->release();
+		pass.reset();
+		if(upscaler.uniforms) upscaler.release();
+		upscaler = {};
+		for(auto& [id, group]: bind_groups) group.release();
+		for(auto& [id, material]: materials) material.release();
+		for(auto& [id, buffer]: buffers) buffer.release();
+		for(auto& [id, texture]: textures) texture.release();
+		for(auto& [id, gbuffer]: gbuffers) gbuffer.release();
+		for(auto& [id, surface]: surfaces) surface.release();
+		bind_groups.clear(); materials.clear(); buffers.clear(); textures.clear(); gbuffers.clear(); surfaces.clear();
+	}
+};
+
+int main(int argc, char** argv) {
+	if(argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <trace> [iterations]" << std::endl;
+		return 1;
+	}
+	size_t iterations = argc > 2 ? std::stoul(argv[2]) : 1;
+
+	std::ifstream file(argv[1], std::ios::binary);
+	std::vector<std::byte> stream;
+	std::transform(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), std::back_inserter(stream), [](char c) { return std::byte(c); });
+	auto reader = stylizer::command_stream_reader::open(stream);
+	if(!reader) {
+		std::cerr << "Failed to open trace: " << argv[1] << std::endl;
+		return 1;
+	}
+
+	stylizer::auto_release context = stylizer::context::create_default();
+	replayer replay{context, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}};
+	try {
+		for(size_t i = 0; i < iterations; ++i) {
+			replay.run(*reader);
+			replay.release();
+		}
+	} catch(std::exception& e) {
+		std::cerr << "Replay failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	auto& times = replay.frame_times;
+	if(times.empty()) {
+		std::cout << "Trace contains no frames" << std::endl;
+		return 0;
+	}
+	using milliseconds = std::chrono::duration<double, std::milli>;
+	auto total = std::accumulate(times.begin(), times.end(), clock_type::duration{});
+	auto sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p) { return milliseconds(sorted[std::min<size_t>(sorted.size() - 1, p * sorted.size())]).count(); };
+
+	std::cout << times.size() << " frames over " << iterations << " iterations (the first frame of each includes resource creation)" << std::endl;
+	std::cout << "\tCPU frame time: " << milliseconds(total).count() / times.size() << " ms average, "
+		<< percentile(.5) << " ms p50, " << percentile(.95) << " ms p95, " << percentile(.99) << " ms p99, "
+		<< milliseconds(sorted.front()).count() << " ms min, " << milliseconds(sorted.back()).count() << " ms max" << std::endl;
+
+	context.release(true);
+}
@@ -4,6 +4,15 @@
 int main() {
 	stylizer::auto_release window = stylizer::window::create({800, 600});
 	stylizer::auto_release context = window.create_context();
+	auto trace = std::getenv("STYLIZER_TRACE"); // Capture a trace for stylizer_replay
+	if(trace) context.recorder = std::make_shared<stylizer::command_recorder>();
+	auto pipelines = std::getenv("STYLIZER_PIPELINE_MANIFEST"); // Prewarm last run's pipelines
+	if(pipelines) {
+		context.pipelines = std::make_shared<stylizer::pipeline_manifest>();
+		context.pipelines->load(pipelines);
+		context.pipelines->prewarm();
+		context.pipelines->build_pipelines(context);
+	}
 	window.reconfigure_surface_on_resize(context, window.determine_optimal_config(context));
 
 	stylizer::auto_release gbuffer = stylizer::gbuffer::create_default(context, window.get_size());
@@ -57,19 +66,43 @@ fragment_output fragment() {
 		}, gbuffer);
 	}
 
+	// With STYLIZER_TRACK_ALLOCATIONS, steady state frames (after warmup, not resizing) must not touch the heap
+	constexpr size_t warmup_frames = 10;
+	size_t frame = 0, resized_frame = 0;
+	bool failed = false;
+	window.resized.emplace_back([&](stylizer::window&, stylizer::uint2) { resized_frame = frame; });
+	stylizer::allocation_counter allocations;
+
+	stylizer::final_composite composite;
 	while(!window.should_close(context)) {
-		gbuffer.begin_drawing(context, stylizer::float3{.1, .3, .5})
-			.bind_render_pipeline(context, material.pipeline)
+		composite.begin_drawing(context, gbuffer, stylizer::float3{.1, .3, .5})
+			.bind_material(context, material)
 			.draw(context, 3)
 			.one_shot_submit(context);
 
 		// try {
-			context.get_surface_texture().blit_from(context, gbuffer.color);
-			context.present();
+			composite.present(context, gbuffer);
 		// } catch(stylizer::api::surface::texture_acquisition_failed e) {
 		// 	std::cerr << e.what() << std::endl;
 		// }
+
+		if constexpr(stylizer::allocation_counter::enabled)
+			if(++frame > resized_frame + warmup_frames && allocations.allocations()) {
+				std::cerr << "Steady state frame " << frame << " performed " << allocations.allocations() << " heap allocations" << std::endl;
+				failed = true;
+				break;
+			}
+		allocations.reset(); // Reset last so should_close (next_frame, events, the scheduler pump) is measured too
+	}
+	composite.stats.print_report(std::cout);
+	if(trace) context.recorder->save(trace);
+	if(pipelines) {
+		context.pipelines->save(pipelines);
+		context.pipelines->stats.print_report(std::cout);
 	}
 
+	material.release();
+	gbuffer.release();
 	context.release(true);
+	return failed;
 }
\ No newline at end of file